@@ -0,0 +1,94 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include "highway_map.h"
+#include "dense_track.h"
+#include "alloc_counter.h"
+#include "planner_session.h"
+#include "highway_sim.h"
+
+using namespace std;
+
+#ifndef PLANNER_COUNT_ALLOCATIONS
+#error "alloc_check is built with PLANNER_COUNT_ALLOCATIONS and alloc_counter.cpp"
+#endif
+
+/****************************************************************/
+/* Test of the allocation counting build: drives the planner in process
+ * against HighwaySim with counting on, where any heap allocation in a
+ * planning cycle aborts, with the s,d of the traffic as reported and
+ * re-derived. Checks first that the counter sees an allocation at all,
+ * so a missing operator new cannot pass as zero:
+ * alloc_check [map.csv] [seconds] [vehicles] */
+/****************************************************************/
+int main(int argc, char *argv[])
+{
+    string map_file_ = (argc > 1) ? argv[1] : "../data/highway_map.csv";
+    double sim_seconds = (argc > 2) ? atof(argv[2]) : 60;
+
+    SimConfig config;
+    if(argc > 3)
+    {
+        config.vehicles = atoi(argv[3]);
+    }
+
+    {
+        AllocationScope probe;
+        std::string *p = new std::string(64, 'x');
+        long seen = probe.count();
+        delete p;
+        if(seen < 1)
+        {
+            cerr << "Allocations are not counted, operator new is not replaced" << endl;
+            return 1;
+        }
+    }
+
+    HighwayMap map;
+    if(!map.loadCsv(map_file_))
+    {
+        cerr << "Failed to read waypoints from " << map_file_ << endl;
+        return -1;
+    }
+    map.buildIndex();
+    DenseTrack track;
+    track.build(map);
+
+    // Once with the reported s,d and once re-deriving them from x,y
+    for(int rederive = 0; rederive < 2; rederive++)
+    {
+        HighwaySim sim(map, track, config);
+        if(sim.vehicles() < config.vehicles)
+        {
+            cerr << "Only " << sim.vehicles() << " of " << config.vehicles << " vehicles fit on the road" << endl;
+            return -1;
+        }
+
+        WorkerPool workers;
+        CandidateConfig candidateConfig;
+        candidateConfig.track_length = track.maxS();
+        PlannerSession session(track, workers, candidateConfig);
+        if(rederive)
+        {
+            session.rederiveFrenet(map);
+        }
+
+        // Every planning cycle checks itself, expectNone() aborts on the first allocation
+        uint64_t frames = (uint64_t)(sim_seconds / 0.02 / config.ticks_per_frame);
+        string frame, reply;
+        for(uint64_t i = 0; i < frames; i++)
+        {
+            sim.telemetry(frame);
+            if(!session.onMessage(frame.data(), frame.size(), reply) || !sim.control(reply.data(), reply.size()))
+            {
+                cerr << "Planner stopped replying after " << i << " frames" << endl;
+                return 1;
+            }
+        }
+
+        cout << session.cycles() << " planning cycles with " << config.vehicles << " vehicles"
+             << (rederive ? ", s,d re-derived," : ",") << " no heap allocations" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <cstdlib>
+#include <new>
+#include "alloc_counter.h"
+
+/****************************************************************/
+/* Replacements of the global allocation functions for the
+ * PLANNER_COUNT_ALLOCATIONS test build: every form of operator new
+ * counts into the thread's AllocationScope, every form of delete frees */
+/****************************************************************/
+#ifdef PLANNER_COUNT_ALLOCATIONS
+
+static void *countedAlloc(std::size_t size)
+{
+    if(alloc_counter::active())
+    {
+        alloc_counter::count()++;
+    }
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new(std::size_t size)
+{
+    void *p = countedAlloc(size);
+    if(p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#endif /* PLANNER_COUNT_ALLOCATIONS */
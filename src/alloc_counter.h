@@ -0,0 +1,77 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdlib>
+#include <iostream>
+
+/****************************************************************/
+/* Heap allocation counting for the PLANNER_COUNT_ALLOCATIONS test
+ * build. The global operator new and delete that count are replaced in
+ * alloc_counter.cpp, linked only into the executables built with the
+ * define. In regular builds AllocationScope compiles to nothing */
+/****************************************************************/
+#ifdef PLANNER_COUNT_ALLOCATIONS
+
+namespace alloc_counter
+{
+// Allocations made by this thread while a scope was open
+inline long &count()
+{
+    static thread_local long allocations = 0;
+    return allocations;
+}
+inline bool &active()
+{
+    static thread_local bool counting = false;
+    return counting;
+}
+}
+
+/****************************************************************/
+/* Counts the heap allocations made by the current thread while alive */
+/****************************************************************/
+class AllocationScope
+{
+public:
+    AllocationScope() : m_start(alloc_counter::count())
+    {
+        alloc_counter::active() = true;
+    }
+    ~AllocationScope()
+    {
+        alloc_counter::active() = false;
+    }
+
+    long count() const
+    {
+        return alloc_counter::count() - m_start;
+    }
+
+    // Aborts the test build when anything was allocated inside the scope
+    void expectNone(const char *what) const
+    {
+        long allocations = count();
+        if(allocations > 0)
+        {
+            alloc_counter::active() = false;
+            std::cerr << what << " made " << allocations << " heap allocations" << std::endl;
+            std::abort();
+        }
+    }
+
+private:
+    long m_start;
+};
+
+#else
+
+class AllocationScope
+{
+public:
+    long count() const { return 0; }
+    void expectNone(const char *) const {}
+};
+
+#endif /* PLANNER_COUNT_ALLOCATIONS */
+
+#endif /* ALLOC_COUNTER_H */
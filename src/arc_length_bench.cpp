@@ -0,0 +1,175 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "highway_map.h"
+#include "dense_track.h"
+#include "spline.h"
+#include "arc_length_sampler.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+const int anchors = 5;
+const int points = 50;
+
+/****************************************************************/
+/* Anchors the way the planner picks them: the end of the previous path
+ * and the point before it, then three points 30 m apart on the target
+ * lane, at random places around the track and with random lane changes */
+/****************************************************************/
+static void makeAnchors(const DenseTrack &track, int count, vector<double> &xs, vector<double> &ys)
+{
+    mt19937 random(1);
+    uniform_real_distribution<double> along(0, track.maxS());
+    uniform_int_distribution<int> lane(0, 2);
+    uniform_int_distribution<int> change(-1, 1);
+    for(int f = 0; f < count; f++)
+    {
+        double s = along(random);
+        int from = lane(random);
+        int to = min(max(from + change(random), 0), 2);
+        XY pts[anchors] = {track.getXY(s - 0.44, 2 + 4 * from), track.getXY(s, 2 + 4 * from),
+                           track.getXY(s + 30, 2 + 4 * to), track.getXY(s + 60, 2 + 4 * to),
+                           track.getXY(s + 90, 2 + 4 * to)};
+        for(const XY &p : pts)
+        {
+            xs.push_back(p.x);
+            ys.push_back(p.y);
+        }
+    }
+}
+
+/****************************************************************/
+/* The fill of the planner before the sampler: y = f(x) fitted in the car
+ * frame, points spaced evenly in x by the chord to (30, f(30)) */
+/****************************************************************/
+static void fillByChord(tk::spline &fit, vector<double> &x, vector<double> &y, const double *ax, const double *ay,
+                        double step, double *out_x, double *out_y)
+{
+    double ref_x = ax[1], ref_y = ay[1];
+    double yaw = atan2(ay[1] - ay[0], ax[1] - ax[0]);
+    for(int k = 0; k < anchors; k++)
+    {
+        double shift_x = ax[k] - ref_x;
+        double shift_y = ay[k] - ref_y;
+        x[k] = shift_x * cos(0 - yaw) - shift_y * sin(0 - yaw);
+        y[k] = shift_x * sin(0 - yaw) + shift_y * cos(0 - yaw);
+    }
+    fit.set_points(x, y);
+
+    double target_x = 30.0;
+    double target_y = fit(target_x);
+    double target_dist = sqrt(target_x * target_x + target_y * target_y);
+    double x_add_on = 0;
+    for(int i = 0; i < points; i++)
+    {
+        double N = target_dist / step;
+        double x_point = x_add_on + target_x / N;
+        double y_point = fit(x_point);
+        x_add_on = x_point;
+
+        out_x[i] = ref_x + x_point * cos(yaw) - y_point * sin(yaw);
+        out_y[i] = ref_y + x_point * sin(yaw) + y_point * cos(yaw);
+    }
+}
+
+// The planner's fill now
+static void fillByArcLength(tk::spline2d<anchors> &fit, ArcLengthSampler<tk::spline2d<anchors> > &arc_s,
+                            const double *ax, const double *ay, const double *steps, double *ts,
+                            double *out_x, double *out_y)
+{
+    fit.set_points(ax, ay);
+    arc_s.build(fit, fit.t_at(1), fit.t_at(anchors - 1));
+    arc_s.sample(steps, points, ts);
+    fit.eval_sorted(ts, out_x, out_y, points);
+}
+
+// Largest relative difference of the per-tick distances to the requested step
+static double speedError(double x0, double y0, const double *xs, const double *ys, double step)
+{
+    double worst = 0;
+    for(int i = 0; i < points; i++)
+    {
+        double dist = (i == 0) ? distance(x0, y0, xs[0], ys[0]) : distance(xs[i - 1], ys[i - 1], xs[i], ys[i]);
+        worst = max(worst, fabs(dist - step) / step);
+    }
+    return worst;
+}
+
+/****************************************************************/
+/* Spaces the 50 points of the planner's path along fits made at random
+ * places of the track, once by the chord to x = 30 the planner used
+ * first and once with ArcLengthSampler, and reports the worst per-tick
+ * speed error of both and their time per fit. Fails if the sampler is
+ * off by more than 0.01%: arc_length_bench [map.csv] [fits] [mph] */
+/****************************************************************/
+int main(int argc, char *argv[])
+{
+    string map_file_ = (argc > 1) ? argv[1] : "../data/highway_map.csv";
+    int fits = (argc > 2) ? atoi(argv[2]) : 20000;
+    double mph = (argc > 3) ? atof(argv[3]) : 49.5;
+
+    HighwayMap map;
+    if(!map.loadCsv(map_file_))
+    {
+        cerr << "Failed to read waypoints from " << map_file_ << endl;
+        return -1;
+    }
+    map.buildArcLength();
+    DenseTrack track;
+    track.build(map);
+
+    vector<double> anchor_x, anchor_y;
+    makeAnchors(track, fits, anchor_x, anchor_y);
+
+    double step = 0.02 * mph / 2.24;
+    double steps[points], ts[points], xs[points], ys[points];
+    for(int i = 0; i < points; i++)
+    {
+        steps[i] = step;
+    }
+
+    tk::spline chord_fit;
+    vector<double> x(anchors), y(anchors);
+    tk::spline2d<anchors> fit;
+    ArcLengthSampler<tk::spline2d<anchors> > arc_s;
+
+    double chord_error = 0, arc_error = 0;
+    for(int f = 0; f < fits; f++)
+    {
+        const double *ax = &anchor_x[f * anchors], *ay = &anchor_y[f * anchors];
+        fillByChord(chord_fit, x, y, ax, ay, step, xs, ys);
+        chord_error = max(chord_error, speedError(ax[1], ay[1], xs, ys, step));
+        fillByArcLength(fit, arc_s, ax, ay, steps, ts, xs, ys);
+        arc_error = max(arc_error, speedError(ax[1], ay[1], xs, ys, step));
+    }
+
+    double sink = 0;
+    Clock::time_point start = Clock::now();
+    for(int f = 0; f < fits; f++)
+    {
+        fillByChord(chord_fit, x, y, &anchor_x[f * anchors], &anchor_y[f * anchors], step, xs, ys);
+        sink += xs[points - 1];
+    }
+    double chord_ns = chrono::duration<double, nano>(Clock::now() - start).count() / fits;
+
+    start = Clock::now();
+    for(int f = 0; f < fits; f++)
+    {
+        fillByArcLength(fit, arc_s, &anchor_x[f * anchors], &anchor_y[f * anchors], steps, ts, xs, ys);
+        sink += xs[points - 1];
+    }
+    double arc_ns = chrono::duration<double, nano>(Clock::now() - start).count() / fits;
+
+    bool accurate = arc_error <= 1e-4;
+    cout << fits << " fits, " << points << " points at " << mph << " mph" << endl;
+    cout << "worst per-tick speed error: chord " << chord_error * 100 << "%, arc length " << arc_error * 100 << "%"
+         << (accurate ? "" : " (too large)") << endl;
+    cout << "chord " << chord_ns << " ns/fit, arc length " << arc_ns << " ns/fit" << (sink == 0 ? " " : "") << endl;
+    return accurate ? 0 : 1;
+}
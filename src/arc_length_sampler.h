@@ -0,0 +1,141 @@
+#ifndef ARC_LENGTH_SAMPLER_H
+#define ARC_LENGTH_SAMPLER_H
+
+#include <math.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include "spline.h"
+
+/****************************************************************/
+/* Speed |dP/dt| of a curve at sorted parameters: P = (x, f(x)) for the
+ * tk splines, P = (x(t), y(t)) for tk::spline2d */
+/****************************************************************/
+template<typename Spline>
+void curveSpeed(const Spline &fit, const double *ts, double *speed, size_t n)
+{
+    // slopes computed into speed, the values go to a stack block
+    const size_t block = 64;
+    double values[block];
+    for(size_t start = 0; start < n; start += block)
+    {
+        size_t len = std::min(block, n - start);
+        fit.eval_sorted(ts + start, values, len, speed + start);
+    }
+    for(size_t i = 0; i < n; i++)
+    {
+        speed[i] = sqrt(1.0 + speed[i] * speed[i]);
+    }
+}
+
+template<size_t N>
+void curveSpeed(const tk::spline2d<N> &fit, const double *ts, double *speed, size_t n)
+{
+    const size_t block = 64;
+    double xs[block], ys[block], dxs[block], dys[block];
+    for(size_t start = 0; start < n; start += block)
+    {
+        size_t len = std::min(block, n - start);
+        fit.eval_sorted(ts + start, xs, ys, len, dxs, dys);
+        for(size_t i = 0; i < len; i++)
+        {
+            speed[start + i] = sqrt(dxs[i] * dxs[i] + dys[i] * dys[i]);
+        }
+    }
+}
+
+/****************************************************************/
+/* Arc-length lookup for a fitted curve, either y = f(x) or a
+ * parametric tk::spline2d. build() tabulates the arc length s(t) once
+ * per fit with Simpson's rule, sample() then turns per-tick travel
+ * distances into curve parameters in a single forward pass, inverting
+ * s(t) with a cubic Hermite interpolant whose slopes dt/ds = 1/|dP/dt|
+ * are already known at the nodes. There is no root finding per point
+ * and the spacing along the curve, i.e. the speed, matches the
+ * requested profile also on curves where the chord approximation
+ * undershoots */
+/****************************************************************/
+template<typename Spline>
+class ArcLengthSampler
+{
+public:
+    // Table intervals, Simpson needs a midpoint in each one
+    static const int intervals = 32;
+
+    // Tabulates s(t) over [t_begin, t_end], t_end should reach past the end
+    // of the path, distances beyond it are extrapolated along the end tangent
+    void build(const Spline &fit, double t_begin, double t_end);
+
+    // Arc length from t_begin to t_end
+    double length() const { return m_s[intervals]; }
+
+    // Parameters of the points at the cumulative distances step[0],
+    // step[0]+step[1], ... from t_begin along the curve, n points written
+    // to t_out
+    void sample(const double *step, size_t n, double *t_out) const;
+
+private:
+    std::array<double, intervals + 1> m_t;
+    std::array<double, intervals + 1> m_s;
+    std::array<double, intervals + 1> m_dtds;     // 1 / |dP/dt|
+};
+
+template<typename Spline>
+void ArcLengthSampler<Spline>::build(const Spline &fit, double t_begin, double t_end)
+{
+    // Nodes and midpoints interleaved, so one sorted evaluation gives all
+    // the speeds
+    const int evalPoints = 2 * intervals + 1;
+    double ts[evalPoints], speed[evalPoints];
+    double h = (t_end - t_begin) / (2 * intervals);
+    for(int i = 0; i < evalPoints; i++)
+    {
+        ts[i] = t_begin + i * h;
+    }
+    curveSpeed(fit, ts, speed, evalPoints);
+
+    m_s[0] = 0;
+    for(int k = 0; k <= intervals; k++)
+    {
+        m_t[k] = ts[2 * k];
+        m_dtds[k] = 1.0 / speed[2 * k];
+        if(k > 0)
+        {
+            m_s[k] = m_s[k - 1] + h / 3 * (speed[2 * k - 2] + 4 * speed[2 * k - 1] + speed[2 * k]);
+        }
+    }
+}
+
+template<typename Spline>
+void ArcLengthSampler<Spline>::sample(const double *step, size_t n, double *t_out) const
+{
+    double s = 0;
+    int k = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+        s += step[i];
+        while(k < intervals - 1 && m_s[k + 1] < s)
+        {
+            k++;
+        }
+
+        if(s >= m_s[intervals])
+        {
+            // Past the table, continue along the end tangent
+            t_out[i] = m_t[intervals] + (s - m_s[intervals]) * m_dtds[intervals];
+            continue;
+        }
+
+        // Cubic Hermite of t(s) on [s_k, s_k+1]
+        double ds = m_s[k + 1] - m_s[k];
+        double u = (s - m_s[k]) / ds;
+        double u2 = u * u;
+        double u3 = u2 * u;
+        t_out[i] = (2 * u3 - 3 * u2 + 1) * m_t[k]
+                   + (u3 - 2 * u2 + u) * ds * m_dtds[k]
+                   + (-2 * u3 + 3 * u2) * m_t[k + 1]
+                   + (u3 - u2) * ds * m_dtds[k + 1];
+    }
+}
+
+#endif /* ARC_LENGTH_SAMPLER_H */
@@ -0,0 +1,352 @@
+#ifndef CANDIDATE_PLANNER_H
+#define CANDIDATE_PLANNER_H
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "quintic_trajectory.h"
+#include "worker_pool.h"
+
+/****************************************************************/
+/* Candidate grid, limits and cost weights. Speeds in m/s, distances
+ * in m, times in s */
+/****************************************************************/
+struct CandidateConfig
+{
+    int lanes = 3;
+    double lane_width = 4.0;
+    double track_length = 0;            // s wraps here, 0 for no wrap
+
+    // Grid: every lane x speeds target speeds up to max_speed x horizons
+    // from min_horizon on in horizon_step increments
+    int speeds = 12;
+    double max_speed = 49.0 / 2.24;
+    int horizons = 14;
+    double min_horizon = 1.5;
+    double horizon_step = 0.5;
+
+    // Feasibility
+    double max_accel = 9.0;
+    double max_jerk = 9.0;
+    double safe_gap = 8.0;              // closest allowed s distance to a car in reach
+    double sample_dt = 0.1;
+
+    double w_progress = 10.0;           // times the fraction below max_speed at the end
+    double w_comfort = 0.02;            // times the mean squared jerk
+    double w_proximity = 20.0;          // times exp(-gap / 10) of the closest car ahead
+    double w_lane_change = 1.0;
+
+    // Candidates not scored once a cycle has taken this long, 0 for no
+    // budget. Without one the choice depends on the frames alone, not on
+    // how fast they are planned
+    double budget_ms = 5.0;
+};
+
+/****************************************************************/
+/* The winning candidate of a cycle */
+/****************************************************************/
+struct CandidateChoice
+{
+    int index;
+    int lane;
+    double speed;                       // target speed at the end of the horizon
+    double horizon;
+    double cost;
+};
+
+/****************************************************************/
+/* Generates lane x target speed x horizon quintic candidates from the
+ * ego Frenet state every cycle and scores them for collision, comfort
+ * and progress on the worker pool. The lanes alternate in the order
+ * the candidates are scored in, so a budget that runs out leaves every
+ * lane with the same share. All columns are sized once in the
+ * constructor, a cycle only rewrites them */
+/****************************************************************/
+class CandidatePlanner
+{
+public:
+    CandidatePlanner(WorkerPool &pool, const CandidateConfig &config = CandidateConfig());
+
+    const CandidateConfig &config() const { return m_config; }
+
+    // Other vehicles at the time of the ego state passed to plan() minus delay
+    void clearVehicles();
+    void addVehicle(double s, double d, double speed);
+
+    // Scores every candidate starting from the ego state s, d, which lies
+    // delay seconds after the vehicle positions. False when no candidate
+    // scored within the budget is feasible
+    bool plan(const QuinticState &s, const QuinticState &d, double delay, CandidateChoice &best);
+    // Cheapest feasible candidate of the last plan() ending in the given
+    // lane, false when there is none
+    bool bestInLane(int lane, CandidateChoice &best) const;
+
+    int candidates() const { return m_batch.size(); }
+    // Candidates of the last cycle that were scored before the budget ran out
+    int scored() const { return m_scored; }
+    double latencyMs() const { return m_latency_ms; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    enum Verdict : uint8_t
+    {
+        skipped,
+        infeasible,
+        feasible
+    };
+
+    void generate(const QuinticState &s, const QuinticState &d);
+    void scoreRange(int begin, int end);
+    double scoreOne(int i, bool &ok) const;
+    double wrapGap(double gap) const;
+    void choice(int i, CandidateChoice &c) const;
+
+    WorkerPool &m_pool;
+    CandidateConfig m_config;
+    QuinticHorizons m_horizons;
+    QuinticBatch m_batch;
+
+    std::vector<int> m_lane;
+    std::vector<double> m_speed;
+    std::vector<double> m_cost;
+    std::vector<uint8_t> m_verdict;
+    std::vector<int> m_lane_best;       // per lane, -1 if none feasible
+
+    std::vector<double> m_vehicle_s, m_vehicle_d, m_vehicle_v;
+
+    int m_ego_lane = 0;
+    double m_delay = 0;
+    Clock::time_point m_deadline;
+    int m_scored = 0;
+    double m_latency_ms = 0;
+};
+
+inline CandidatePlanner::CandidatePlanner(WorkerPool &pool, const CandidateConfig &config)
+    : m_pool(pool), m_config(config), m_batch(m_horizons)
+{
+    for(int h = 0; h < m_config.horizons; h++)
+    {
+        m_horizons.add(m_config.min_horizon + h * m_config.horizon_step);
+    }
+
+    int capacity = m_config.lanes * m_config.speeds * m_config.horizons;
+    m_batch.reserve(capacity);
+    m_lane.reserve(capacity);
+    m_speed.reserve(capacity);
+    m_cost.resize(capacity);
+    m_verdict.resize(capacity);
+    m_lane_best.resize(m_config.lanes);
+
+    const int typicalVehicles = 64;
+    m_vehicle_s.reserve(typicalVehicles);
+    m_vehicle_d.reserve(typicalVehicles);
+    m_vehicle_v.reserve(typicalVehicles);
+}
+
+inline void CandidatePlanner::clearVehicles()
+{
+    m_vehicle_s.clear();
+    m_vehicle_d.clear();
+    m_vehicle_v.clear();
+}
+
+inline void CandidatePlanner::addVehicle(double s, double d, double speed)
+{
+    m_vehicle_s.push_back(s);
+    m_vehicle_d.push_back(d);
+    m_vehicle_v.push_back(speed);
+}
+
+inline double CandidatePlanner::wrapGap(double gap) const
+{
+    double length = m_config.track_length;
+    if(length > 0)
+    {
+        if(gap > length / 2)
+        {
+            gap -= length;
+        }
+        else if(gap < -length / 2)
+        {
+            gap += length;
+        }
+    }
+    return gap;
+}
+
+inline void CandidatePlanner::generate(const QuinticState &s, const QuinticState &d)
+{
+    m_batch.clear();
+    m_lane.clear();
+    m_speed.clear();
+    // Lane innermost, so consecutive candidates differ in lane only
+    for(int k = 0; k < m_config.speeds; k++)
+    {
+        double speed = m_config.max_speed * (k + 1) / m_config.speeds;
+        for(int h = 0; h < m_horizons.size(); h++)
+        {
+            // Travel as under constant acceleration to the target speed
+            double horizon = m_horizons.horizon(h);
+            QuinticState s_end = {s.p + 0.5 * (s.v + speed) * horizon, speed, 0};
+            for(int lane = 0; lane < m_config.lanes; lane++)
+            {
+                QuinticState d_end = {m_config.lane_width * (lane + 0.5), 0, 0};
+                m_batch.add(s, s_end, d, d_end, h);
+                m_lane.push_back(lane);
+                m_speed.push_back(speed);
+            }
+        }
+    }
+    m_batch.solve();
+}
+
+inline double CandidatePlanner::scoreOne(int i, bool &ok) const
+{
+    const CandidateConfig &c = m_config;
+    double s_c[6], d_c[6];
+    for(int k = 0; k < 6; k++)
+    {
+        s_c[k] = m_batch.sCoeff(i, k);
+        d_c[k] = m_batch.dCoeff(i, k);
+    }
+
+    double horizon = m_batch.horizon(i);
+    int steps = (int)ceil(horizon / c.sample_dt);
+    double jerk2 = 0;
+    double proximity = 0;
+    int vehicles = m_vehicle_s.size();
+    ok = false;
+
+    for(int step = 1; step <= steps; step++)
+    {
+        double t = std::min(step * c.sample_dt, horizon);
+        QuinticState s = m_batch.s(i, t);
+        QuinticState d = m_batch.d(i, t);
+        double s_jerk = (60 * s_c[5] * t + 24 * s_c[4]) * t + 6 * s_c[3];
+        double d_jerk = (60 * d_c[5] * t + 24 * d_c[4]) * t + 6 * d_c[3];
+
+        if(s.v < -0.1 || s.v > c.max_speed + 0.1
+           || s.a * s.a + d.a * d.a > c.max_accel * c.max_accel
+           || s_jerk * s_jerk + d_jerk * d_jerk > c.max_jerk * c.max_jerk)
+        {
+            return 0;
+        }
+        jerk2 += (s_jerk * s_jerk + d_jerk * d_jerk) * c.sample_dt;
+
+        double when = m_delay + t;
+        for(int v = 0; v < vehicles; v++)
+        {
+            // Only cars overlapping the ego width, i.e. sharing a lane with it
+            if(fabs(m_vehicle_d[v] - d.p) > 0.6 * c.lane_width)
+            {
+                continue;
+            }
+            double gap = wrapGap(m_vehicle_s[v] + m_vehicle_v[v] * when - s.p);
+            if(fabs(gap) < c.safe_gap)
+            {
+                return 0;
+            }
+            if(gap > 0)
+            {
+                proximity = std::max(proximity, exp(-gap / 10));
+            }
+        }
+    }
+
+    double end_speed = m_batch.s(i, horizon).v;
+    ok = true;
+    return c.w_progress * (c.max_speed - end_speed) / c.max_speed
+           + c.w_comfort * jerk2 / horizon
+           + c.w_proximity * proximity
+           + c.w_lane_change * (m_lane[i] != m_ego_lane ? 1 : 0);
+}
+
+inline void CandidatePlanner::scoreRange(int begin, int end)
+{
+    for(int i = begin; i < end; i++)
+    {
+        if(m_config.budget_ms > 0 && Clock::now() > m_deadline)
+        {
+            m_verdict[i] = skipped;
+            continue;
+        }
+        bool ok;
+        m_cost[i] = scoreOne(i, ok);
+        m_verdict[i] = ok ? feasible : infeasible;
+    }
+}
+
+inline bool CandidatePlanner::plan(const QuinticState &s, const QuinticState &d, double delay, CandidateChoice &best)
+{
+    Clock::time_point start = Clock::now();
+    m_deadline = start + std::chrono::microseconds((int64_t)(m_config.budget_ms * 1000));
+    m_delay = delay;
+    m_ego_lane = std::min(std::max((int)floor(d.p / m_config.lane_width), 0), m_config.lanes - 1);
+
+    generate(s, d);
+
+    struct Scorer
+    {
+        CandidatePlanner *planner;
+        void operator()(int begin, int end) { planner->scoreRange(begin, end); }
+    } scorer = {this};
+    const int chunk = 16;
+    m_pool.parallelFor(m_batch.size(), chunk, scorer);
+
+    int found = -1;
+    m_scored = 0;
+    std::fill(m_lane_best.begin(), m_lane_best.end(), -1);
+    for(int i = 0; i < m_batch.size(); i++)
+    {
+        if(m_verdict[i] == skipped)
+        {
+            continue;
+        }
+        m_scored++;
+        if(m_verdict[i] != feasible)
+        {
+            continue;
+        }
+        int &lane_best = m_lane_best[m_lane[i]];
+        if(lane_best < 0 || m_cost[i] < m_cost[lane_best])
+        {
+            lane_best = i;
+        }
+        if(found < 0 || m_cost[i] < m_cost[found])
+        {
+            found = i;
+        }
+    }
+    m_latency_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    if(found < 0)
+    {
+        return false;
+    }
+    choice(found, best);
+    return true;
+}
+
+inline bool CandidatePlanner::bestInLane(int lane, CandidateChoice &best) const
+{
+    if(lane < 0 || lane >= m_config.lanes || m_lane_best[lane] < 0)
+    {
+        return false;
+    }
+    choice(m_lane_best[lane], best);
+    return true;
+}
+
+inline void CandidatePlanner::choice(int i, CandidateChoice &c) const
+{
+    c.index = i;
+    c.lane = m_lane[i];
+    c.speed = m_speed[i];
+    c.horizon = m_batch.horizon(i);
+    c.cost = m_cost[i];
+}
+
+#endif /* CANDIDATE_PLANNER_H */
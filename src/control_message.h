@@ -0,0 +1,128 @@
+#ifndef CONTROL_MESSAGE_H
+#define CONTROL_MESSAGE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+/****************************************************************/
+/* Writer for the control message sent back to the simulator,
+ * 42["control",{"next_x":[...],"next_y":[...]}], straight into a
+ * reused reply buffer. Coordinates are written in fixed point with
+ * up to 9 decimals, a nanometer, trailing zeros dropped; values too
+ * large for that fall back to printf. Both are plain json numbers */
+/****************************************************************/
+namespace control_message
+{
+// Longest number written: sign, 17 significant digits, point and exponent
+const int max_number_length = 25;
+const int decimals = 9;
+const uint64_t decimal_scale = 1000000000;
+// Largest magnitude written in fixed point, scaled it stays exact in a double
+const double max_fixed = 1e6;
+
+inline char *writeDigits(char *out, uint64_t value, int min_digits)
+{
+    char digits[20];
+    int n = 0;
+    do
+    {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while(value != 0 || n < min_digits);
+    while(n > 0)
+    {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+inline char *writeNumber(char *out, double value)
+{
+    if(!(fabs(value) < max_fixed))
+    {
+        if(!std::isfinite(value))
+        {
+            // What the json writer makes of them
+            out[0] = 'n';
+            out[1] = 'u';
+            out[2] = 'l';
+            out[3] = 'l';
+            return out + 4;
+        }
+        return out + snprintf(out, max_number_length + 1, "%.15g", value);
+    }
+
+    uint64_t scaled = (uint64_t)llround(fabs(value) * decimal_scale);
+    if(scaled == 0)
+    {
+        *out++ = '0';
+        return out;
+    }
+    if(value < 0)
+    {
+        *out++ = '-';
+    }
+    out = writeDigits(out, scaled / decimal_scale, 1);
+    uint64_t fraction = scaled % decimal_scale;
+    if(fraction != 0)
+    {
+        int digits = decimals;
+        while(fraction % 10 == 0)
+        {
+            fraction /= 10;
+            digits--;
+        }
+        *out++ = '.';
+        out = writeDigits(out, fraction, digits);
+    }
+    return out;
+}
+
+inline char *writeText(char *out, const char *text)
+{
+    while(*text != '\0')
+    {
+        *out++ = *text++;
+    }
+    return out;
+}
+
+inline char *writeArray(char *out, const double *values, int n)
+{
+    *out++ = '[';
+    for(int i = 0; i < n; i++)
+    {
+        if(i > 0)
+        {
+            *out++ = ',';
+        }
+        out = writeNumber(out, values[i]);
+    }
+    *out++ = ']';
+    return out;
+}
+
+// Buffer size that holds a message of n points
+inline size_t capacity(int n)
+{
+    return 64 + 2 * (size_t)n * (max_number_length + 1);
+}
+
+// Replaces out with the message, without allocating when out already
+// has capacity(n)
+inline void write(const double *x, const double *y, int n, std::string &out)
+{
+    out.resize(capacity(n));
+    char *begin = &out[0];
+    char *p = writeText(begin, "42[\"control\",{\"next_x\":");
+    p = writeArray(p, x, n);
+    p = writeText(p, ",\"next_y\":");
+    p = writeArray(p, y, n);
+    p = writeText(p, "}]");
+    out.resize(p - begin);
+}
+}
+
+#endif /* CONTROL_MESSAGE_H */
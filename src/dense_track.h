@@ -0,0 +1,168 @@
+#ifndef DENSE_TRACK_H
+#define DENSE_TRACK_H
+
+#include <math.h>
+#include <vector>
+#include "highway_map.h"
+#include "spline.h"
+
+/****************************************************************/
+/* One sample of the smoothed track centerline. The normal points
+ * towards positive d, i.e. it is the heading rotated by -pi/2 */
+/****************************************************************/
+struct TrackSample
+{
+    double x;
+    double y;
+    double heading;
+    double curvature;
+    double nx;
+    double ny;
+};
+
+/****************************************************************/
+/* Closed-loop cubic spline fitted through the map waypoints and
+ * resampled once at a fixed pitch. An (s, d) lookup is an index
+ * computation plus one lerp between neighbouring samples, and the
+ * heading no longer kinks at every waypoint */
+/****************************************************************/
+class DenseTrack
+{
+public:
+    DenseTrack() {}
+    // Views point into the storage, moving keeps the buffer but copying would not
+    DenseTrack(const DenseTrack &) = delete;
+    DenseTrack &operator=(const DenseTrack &) = delete;
+    DenseTrack(DenseTrack &&) = default;
+    DenseTrack &operator=(DenseTrack &&) = default;
+
+    // pitch is the target sample spacing in meters, it is adjusted so an
+    // integral number of samples closes the loop exactly
+    void build(const HighwayMap &map, double pitch = 0.25);
+
+    // Uses samples built earlier, e.g. stored in a map file. The last
+    // sample must repeat the first
+    void attach(ConstArray<TrackSample> samples, double max_s);
+
+    // Transform from Frenet s,d coordinates to Cartesian x,y
+    XY getXY(double s, double d) const;
+
+    // Sample at or just before s
+    const TrackSample &sampleAt(double s) const;
+
+    double maxS() const { return m_max_s; }
+    double pitch() const { return m_pitch; }
+    ConstArray<TrackSample> samples() const { return m_samples; }
+
+private:
+    // Sample index and the fraction towards the next one for a wrapped s
+    int locate(double s, double &t) const;
+
+    ConstArray<TrackSample> m_samples;    // one extra sample repeats the first
+    std::vector<TrackSample> m_store;     // backing storage when built
+    double m_max_s = 0;
+    double m_pitch = 0;
+    double m_inv_pitch = 0;
+};
+
+inline void DenseTrack::build(const HighwayMap &map, double pitch)
+{
+    // Waypoints borrowed from the other end of the loop on each side, so the
+    // fit has no free ends near s = 0 and s = max_s
+    const int wrapPoints = 4;
+
+    int n = map.x.size();
+    m_max_s = map.max_s;
+
+    std::vector<double> knots_s, knots_x, knots_y;
+    for(int i = -wrapPoints; i < n + wrapPoints; i++)
+    {
+        int wp = (i + n) % n;
+        double shift = (i < 0) ? -m_max_s : ((i >= n) ? m_max_s : 0.0);
+        knots_s.push_back(map.arc_s[wp] + shift);
+        knots_x.push_back(map.x[wp]);
+        knots_y.push_back(map.y[wp]);
+    }
+
+    tk::spline fit_x;
+    tk::spline fit_y;
+    fit_x.set_points(knots_s, knots_x);
+    fit_y.set_points(knots_s, knots_y);
+
+    int count = (int)ceil(m_max_s / pitch);
+    m_pitch = m_max_s / count;
+    m_store.resize(count + 1);
+
+    // Derivatives by central differences across half a sample
+    double h = m_pitch / 2;
+    for(int i = 0; i < count; i++)
+    {
+        double s = i * m_pitch;
+        double x0 = fit_x(s), x_lo = fit_x(s - h), x_hi = fit_x(s + h);
+        double y0 = fit_y(s), y_lo = fit_y(s - h), y_hi = fit_y(s + h);
+
+        double dx = (x_hi - x_lo) / (2 * h);
+        double dy = (y_hi - y_lo) / (2 * h);
+        double ddx = (x_hi - 2 * x0 + x_lo) / (h * h);
+        double ddy = (y_hi - 2 * y0 + y_lo) / (h * h);
+
+        TrackSample &sample = m_store[i];
+        sample.x = x0;
+        sample.y = y0;
+        sample.heading = atan2(dy, dx);
+        sample.curvature = (dx * ddy - dy * ddx) / pow(dx * dx + dy * dy, 1.5);
+        sample.nx = sin(sample.heading);
+        sample.ny = -cos(sample.heading);
+    }
+    m_store[count] = m_store[0];
+
+    attach(m_store, m_max_s);
+}
+
+inline void DenseTrack::attach(ConstArray<TrackSample> samples, double max_s)
+{
+    m_samples = samples;
+    m_max_s = max_s;
+    m_pitch = m_max_s / (samples.size() - 1);
+    m_inv_pitch = 1.0 / m_pitch;
+}
+
+inline int DenseTrack::locate(double s, double &t) const
+{
+    s = fmod(s, m_max_s);
+    if(s < 0)
+    {
+        s += m_max_s;
+    }
+
+    double pos = s * m_inv_pitch;
+    int idx = (int)pos;
+    // Guards against pos rounding up to the sample count
+    if(idx >= (int)m_samples.size() - 1)
+    {
+        idx = m_samples.size() - 2;
+    }
+    t = pos - idx;
+    return idx;
+}
+
+inline const TrackSample &DenseTrack::sampleAt(double s) const
+{
+    double t;
+    return m_samples[locate(s, t)];
+}
+
+inline XY DenseTrack::getXY(double s, double d) const
+{
+    double t;
+    int idx = locate(s, t);
+    const TrackSample &a = m_samples[idx];
+    const TrackSample &b = m_samples[idx + 1];
+
+    double x = a.x + t * (b.x - a.x) + d * (a.nx + t * (b.nx - a.nx));
+    double y = a.y + t * (b.y - a.y) + d * (a.ny + t * (b.ny - a.ny));
+
+    return {x, y};
+}
+
+#endif /* DENSE_TRACK_H */
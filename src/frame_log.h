@@ -0,0 +1,322 @@
+#ifndef FRAME_LOG_H
+#define FRAME_LOG_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/****************************************************************/
+/* Log of the raw websocket frames of the planner, received and sent,
+ * written by the server when recording and read back by the replay
+ * harness. Native byte order, every record starts on an 8 byte
+ * boundary so the file can be walked in place when mapped:
+ *
+ *   FrameLogHeader
+ *   FrameLogRecord, stored_size payload bytes, padding to 8   repeated
+ *
+ * A payload is the frame as is or, when recording compressed, deflated
+ * with zlib if that makes it smaller. A log cut short by the server
+ * being killed ends at the last complete record */
+/****************************************************************/
+const char frameLogMagic[8] = {'P', 'P', 'F', 'R', 'A', 'M', 'E', 'S'};
+const uint32_t frameLogVersion = 1;
+const uint32_t frameLogByteOrder = 0x01020304;
+
+struct FrameLogHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // frameLogByteOrder as seen by the writer
+};
+static_assert(sizeof(FrameLogHeader) % 8 == 0, "records must start 8 byte aligned");
+
+enum FrameLogKind : uint8_t
+{
+    frameReceived = 0,
+    frameSent = 1
+};
+
+enum FrameLogEncoding : uint8_t
+{
+    frameRaw = 0,
+    frameDeflated = 1
+};
+
+struct FrameLogRecord
+{
+    uint64_t time_us;           // since the log was opened
+    uint64_t sequence;          // of the received frame, a reply carries that of its frame
+    uint32_t connection;
+    uint32_t stored_size;       // payload bytes in the file
+    uint32_t size;              // frame bytes
+    uint8_t kind;               // FrameLogKind
+    uint8_t encoding;           // FrameLogEncoding
+    uint16_t reserved;
+};
+static_assert(sizeof(FrameLogRecord) % 8 == 0, "payloads must start 8 byte aligned");
+
+/****************************************************************/
+/* Appends frames to a log through a large stdio buffer. Not thread
+ * safe, the server only writes from its event loop */
+/****************************************************************/
+class FrameLogWriter
+{
+public:
+    FrameLogWriter() : m_file(nullptr), m_compress(false) {}
+    ~FrameLogWriter() { close(); }
+    FrameLogWriter(const FrameLogWriter &) = delete;
+    FrameLogWriter &operator=(const FrameLogWriter &) = delete;
+
+    // Creates or truncates the log, false with a reason in error
+    bool open(const std::string &path, bool compress, std::string &error);
+    bool isOpen() const { return m_file != nullptr; }
+
+    void append(FrameLogKind kind, uint32_t connection, uint64_t sequence, const char *data, size_t length);
+    // Pushes buffered records to the file, e.g. when a connection ends
+    void flush();
+    void close();
+
+private:
+    FILE *m_file;
+    bool m_compress;
+    std::chrono::steady_clock::time_point m_start;
+    std::vector<unsigned char> m_deflated;
+};
+
+inline bool FrameLogWriter::open(const std::string &path, bool compress, std::string &error)
+{
+    close();
+    m_file = fopen(path.c_str(), "wb");
+    if(m_file == nullptr)
+    {
+        error = "cannot create " + path;
+        return false;
+    }
+    setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+
+    FrameLogHeader header;
+    memcpy(header.magic, frameLogMagic, sizeof(header.magic));
+    header.version = frameLogVersion;
+    header.byte_order = frameLogByteOrder;
+    if(fwrite(&header, sizeof(header), 1, m_file) != 1)
+    {
+        close();
+        error = "cannot write " + path;
+        return false;
+    }
+    m_compress = compress;
+    m_start = std::chrono::steady_clock::now();
+    return true;
+}
+
+inline void FrameLogWriter::append(FrameLogKind kind, uint32_t connection, uint64_t sequence, const char *data, size_t length)
+{
+    if(m_file == nullptr)
+    {
+        return;
+    }
+
+    FrameLogRecord record;
+    record.time_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+    record.sequence = sequence;
+    record.connection = connection;
+    record.size = length;
+    record.kind = kind;
+    record.encoding = frameRaw;
+    record.reserved = 0;
+
+    const void *payload = data;
+    record.stored_size = length;
+    if(m_compress)
+    {
+        uLongf deflated = compressBound(length);
+        m_deflated.resize(deflated);
+        if(compress2(m_deflated.data(), &deflated, (const Bytef *)data, length, Z_BEST_SPEED) == Z_OK
+           && deflated < length)
+        {
+            payload = m_deflated.data();
+            record.stored_size = deflated;
+            record.encoding = frameDeflated;
+        }
+    }
+
+    static const char padding[8] = {0};
+    fwrite(&record, sizeof(record), 1, m_file);
+    fwrite(payload, 1, record.stored_size, m_file);
+    fwrite(padding, 1, (8 - record.stored_size % 8) % 8, m_file);
+}
+
+inline void FrameLogWriter::flush()
+{
+    if(m_file != nullptr)
+    {
+        fflush(m_file);
+    }
+}
+
+inline void FrameLogWriter::close()
+{
+    if(m_file != nullptr)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+/****************************************************************/
+/* A frame read back from a log. data stays valid until the next
+ * call of FrameLogReader::next() */
+/****************************************************************/
+struct LoggedFrame
+{
+    FrameLogKind kind;
+    uint32_t connection;
+    uint64_t sequence;
+    uint64_t time_us;
+    const char *data;
+    size_t size;
+};
+
+/****************************************************************/
+/* Read-only mapping of a frame log, walked record by record. Raw
+ * frames are handed out straight from the mapped pages */
+/****************************************************************/
+class FrameLogReader
+{
+public:
+    FrameLogReader() : m_base(nullptr), m_length(0), m_offset(0) {}
+    ~FrameLogReader() { close(); }
+    FrameLogReader(const FrameLogReader &) = delete;
+    FrameLogReader &operator=(const FrameLogReader &) = delete;
+
+    // false with a reason in error when the file is missing or not a log
+    bool open(const std::string &path, std::string &error);
+
+    // false at the end of the log; error is set when the rest of it is unreadable
+    bool next(LoggedFrame &frame, std::string &error);
+
+private:
+    void close();
+
+    void *m_base;
+    size_t m_length;
+    size_t m_offset;
+    std::vector<char> m_inflated;
+};
+
+inline void FrameLogReader::close()
+{
+    if(m_base != nullptr)
+    {
+        munmap(m_base, m_length);
+        m_base = nullptr;
+        m_length = 0;
+    }
+}
+
+inline bool FrameLogReader::open(const std::string &path, std::string &error)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FrameLogHeader))
+    {
+        ::close(fd);
+        error = "truncated header";
+        return false;
+    }
+    void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(base == MAP_FAILED)
+    {
+        error = "mmap failed";
+        return false;
+    }
+    m_base = base;
+    m_length = st.st_size;
+
+    const FrameLogHeader *header = static_cast<const FrameLogHeader *>(m_base);
+    if(memcmp(header->magic, frameLogMagic, sizeof(header->magic)) != 0)
+    {
+        close();
+        error = "not a frame log";
+        return false;
+    }
+    if(header->version != frameLogVersion || header->byte_order != frameLogByteOrder)
+    {
+        close();
+        error = "unsupported version or byte order";
+        return false;
+    }
+    m_offset = sizeof(FrameLogHeader);
+    return true;
+}
+
+inline bool FrameLogReader::next(LoggedFrame &frame, std::string &error)
+{
+    error.clear();
+    if(m_base == nullptr || m_offset == m_length)
+    {
+        return false;
+    }
+    const char *base = static_cast<const char *>(m_base);
+    if(m_length - m_offset < sizeof(FrameLogRecord))
+    {
+        error = "truncated record at offset " + std::to_string(m_offset);
+        return false;
+    }
+    const FrameLogRecord *record = reinterpret_cast<const FrameLogRecord *>(base + m_offset);
+    size_t payload = m_offset + sizeof(FrameLogRecord);
+    if(m_length - payload < record->stored_size)
+    {
+        error = "truncated record at offset " + std::to_string(m_offset);
+        return false;
+    }
+
+    frame.kind = (FrameLogKind)record->kind;
+    frame.connection = record->connection;
+    frame.sequence = record->sequence;
+    frame.time_us = record->time_us;
+    frame.size = record->size;
+    if(record->encoding == frameRaw && record->stored_size == record->size)
+    {
+        frame.data = base + payload;
+    }
+    else if(record->encoding == frameDeflated)
+    {
+        m_inflated.resize(record->size);
+        uLongf inflated = record->size;
+        if(uncompress((Bytef *)m_inflated.data(), &inflated, (const Bytef *)(base + payload), record->stored_size) != Z_OK
+           || inflated != record->size)
+        {
+            error = "damaged record at offset " + std::to_string(m_offset);
+            return false;
+        }
+        frame.data = m_inflated.data();
+    }
+    else
+    {
+        error = "damaged record at offset " + std::to_string(m_offset);
+        return false;
+    }
+
+    m_offset = std::min(m_length, payload + ((record->stored_size + 7) & ~size_t(7)));
+    return true;
+}
+
+#endif /* FRAME_LOG_H */
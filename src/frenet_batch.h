@@ -0,0 +1,374 @@
+#ifndef FRENET_BATCH_H
+#define FRENET_BATCH_H
+
+#include <math.h>
+#include <cstddef>
+#include <vector>
+#include "highway_map.h"
+#include "frenet_projector.h"
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/****************************************************************/
+/* Packed double arithmetic used by the batch kernels: AVX when the
+ * build enables it, SSE2 on any x86-64, plain doubles elsewhere and
+ * for the tail of every batch. Only IEEE exact operations are exposed
+ * so results match the scalar getFrenet/getXY bit for bit, as long as
+ * the scalar code is not built with FMA contraction */
+/****************************************************************/
+struct ScalarIsa {};
+struct Sse2Isa {};
+struct AvxIsa {};
+
+template <typename Isa> struct PackOps;
+
+template <> struct PackOps<ScalarIsa>
+{
+    typedef double pack;
+    static const size_t width = 1;
+    static double load(const double *p) { return *p; }
+    static void store(double *p, double a) { *p = a; }
+    static double set1(double a) { return a; }
+    static double add(double a, double b) { return a + b; }
+    static double sub(double a, double b) { return a - b; }
+    static double mul(double a, double b) { return a * b; }
+    static double div(double a, double b) { return a / b; }
+    static double sqrt(double a) { return ::sqrt(a); }
+    // a <= b ? x : y
+    static double selectLe(double a, double b, double x, double y) { return (a <= b) ? x : y; }
+    // a < b ? x : y
+    static double selectLt(double a, double b, double x, double y) { return (a < b) ? x : y; }
+};
+
+#if defined(__SSE2__)
+template <> struct PackOps<Sse2Isa>
+{
+    typedef __m128d pack;
+    static const size_t width = 2;
+    static __m128d load(const double *p) { return _mm_loadu_pd(p); }
+    static void store(double *p, __m128d a) { _mm_storeu_pd(p, a); }
+    static __m128d set1(double a) { return _mm_set1_pd(a); }
+    static __m128d add(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+    static __m128d sub(__m128d a, __m128d b) { return _mm_sub_pd(a, b); }
+    static __m128d mul(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+    static __m128d div(__m128d a, __m128d b) { return _mm_div_pd(a, b); }
+    static __m128d sqrt(__m128d a) { return _mm_sqrt_pd(a); }
+    static __m128d selectLe(__m128d a, __m128d b, __m128d x, __m128d y)
+    {
+        __m128d mask = _mm_cmple_pd(a, b);
+        return _mm_or_pd(_mm_and_pd(mask, x), _mm_andnot_pd(mask, y));
+    }
+    static __m128d selectLt(__m128d a, __m128d b, __m128d x, __m128d y)
+    {
+        __m128d mask = _mm_cmplt_pd(a, b);
+        return _mm_or_pd(_mm_and_pd(mask, x), _mm_andnot_pd(mask, y));
+    }
+};
+#endif
+
+#if defined(__AVX__)
+template <> struct PackOps<AvxIsa>
+{
+    typedef __m256d pack;
+    static const size_t width = 4;
+    static __m256d load(const double *p) { return _mm256_loadu_pd(p); }
+    static void store(double *p, __m256d a) { _mm256_storeu_pd(p, a); }
+    static __m256d set1(double a) { return _mm256_set1_pd(a); }
+    static __m256d add(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+    static __m256d sub(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+    static __m256d mul(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+    static __m256d div(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+    static __m256d sqrt(__m256d a) { return _mm256_sqrt_pd(a); }
+    static __m256d selectLe(__m256d a, __m256d b, __m256d x, __m256d y)
+    {
+        return _mm256_blendv_pd(y, x, _mm256_cmp_pd(a, b, _CMP_LE_OQ));
+    }
+    static __m256d selectLt(__m256d a, __m256d b, __m256d x, __m256d y)
+    {
+        return _mm256_blendv_pd(y, x, _mm256_cmp_pd(a, b, _CMP_LT_OQ));
+    }
+};
+typedef AvxIsa FrenetIsa;
+#elif defined(__SSE2__)
+typedef Sse2Isa FrenetIsa;
+#else
+typedef ScalarIsa FrenetIsa;
+#endif
+
+/****************************************************************/
+/* Batched Frenet conversion over structure-of-arrays buffers. Segment
+ * lookups stay scalar, per-segment constants are gathered into scratch
+ * columns and the projection arithmetic then runs packed. Scratch is
+ * kept between calls, so a steady batch size does not allocate, and
+ * reserve() sizes it up front */
+/****************************************************************/
+class FrenetBatch
+{
+public:
+    explicit FrenetBatch(const HighwayMap &map);
+
+    // Cartesian to Frenet. thetas (radians) may be null, the next waypoint
+    // is then picked by which side of the closest waypoint the point projects
+    // to. With thetas given the result equals getFrenet element for element
+    void toFrenet(const double *xs, const double *ys, const double *thetas, size_t n,
+                  double *s_out, double *d_out);
+
+    // Cartesian to Frenet of tracked vehicles, each projected onto the
+    // segment the projector finds for its id, which it remembers for the
+    // next call. Equal to projector.project element for element
+    void toFrenet(FrenetProjector &projector, const int *ids, const double *xs, const double *ys, size_t n,
+                  double *s_out, double *d_out);
+
+    // Frenet to Cartesian, equal to getXY element for element
+    void toCartesian(const double *ss, const double *ds, size_t n,
+                     double *x_out, double *y_out, SegmentHint *hint = nullptr);
+
+    // Sizes the scratch for batches of up to n
+    void reserve(size_t n);
+
+private:
+    template <typename Isa> void frenetKernel(size_t begin, size_t end, const double *xs, const double *ys,
+                                            double *s_out, double *d_out) const;
+    template <typename Isa> void projectedKernel(size_t begin, size_t end, const double *xs, const double *ys,
+                                               double *s_out, double *d_out) const;
+    template <typename Isa> void cartesianKernel(size_t begin, size_t end, const double *ds,
+                                               double *x_out, double *y_out) const;
+
+    const HighwayMap &m_map;
+
+    // Per segment constants, segment i runs from waypoint i to i+1 (wrapping)
+    std::vector<double> m_nx, m_ny, m_nn;       // direction and its squared length
+    std::vector<double> m_cx, m_cy;             // the (1000, 2000) center seen from waypoint i
+    std::vector<double> m_cos, m_sin;           // heading
+    std::vector<double> m_perp_cos, m_perp_sin; // heading - pi/2
+    std::vector<double> m_len, m_inv_len2;      // length and 1 / length^2, as FrenetProjector has them
+
+    // Gathered columns, one entry per query
+    std::vector<double> m_c0, m_c1, m_c2, m_c3, m_c4, m_c5, m_c6, m_c7;
+};
+
+inline FrenetBatch::FrenetBatch(const HighwayMap &map) : m_map(map)
+{
+    size_t n = map.x.size();
+    m_nx.resize(n); m_ny.resize(n); m_nn.resize(n);
+    m_cx.resize(n); m_cy.resize(n);
+    m_cos.resize(n); m_sin.resize(n);
+    m_perp_cos.resize(n); m_perp_sin.resize(n);
+    m_len.resize(n); m_inv_len2.resize(n);
+
+    // Same expressions as getFrenet/getXY and FrenetProjector so the cached values are identical
+    for(size_t i = 0; i < n; i++)
+    {
+        size_t next = (i + 1) % n;
+        m_nx[i] = map.x[next] - map.x[i];
+        m_ny[i] = map.y[next] - map.y[i];
+        m_nn[i] = m_nx[i] * m_nx[i] + m_ny[i] * m_ny[i];
+        m_cx[i] = 1000 - map.x[i];
+        m_cy[i] = 2000 - map.y[i];
+
+        double heading = atan2((map.y[next] - map.y[i]), (map.x[next] - map.x[i]));
+        double perp_heading = heading - pi() / 2;
+        m_cos[i] = cos(heading);
+        m_sin[i] = sin(heading);
+        m_perp_cos[i] = cos(perp_heading);
+        m_perp_sin[i] = sin(perp_heading);
+        m_len[i] = sqrt(m_nx[i] * m_nx[i] + m_ny[i] * m_ny[i]);
+        m_inv_len2[i] = 1.0 / (m_len[i] * m_len[i]);
+    }
+}
+
+inline void FrenetBatch::reserve(size_t n)
+{
+    if(m_c0.size() < n)
+    {
+        m_c0.resize(n); m_c1.resize(n); m_c2.resize(n); m_c3.resize(n);
+        m_c4.resize(n); m_c5.resize(n); m_c6.resize(n); m_c7.resize(n);
+    }
+}
+
+inline void FrenetBatch::toFrenet(const double *xs, const double *ys, const double *thetas, size_t n,
+                                  double *s_out, double *d_out)
+{
+    reserve(n);
+    int wp_count = m_map.x.size();
+
+    // Scalar pass: pick the segment and gather its constants
+    for(size_t i = 0; i < n; i++)
+    {
+        int next_wp;
+        if(thetas != nullptr)
+        {
+            next_wp = NextWaypoint(xs[i], ys[i], thetas[i], m_map);
+        }
+        else
+        {
+            int closest = ClosestWaypoint(xs[i], ys[i], m_map);
+            double ahead = (xs[i] - m_map.x[closest]) * m_nx[closest] + (ys[i] - m_map.y[closest]) * m_ny[closest];
+            next_wp = (ahead > 0) ? (closest + 1) % wp_count : closest;
+        }
+        int prev_wp = (next_wp == 0) ? wp_count - 1 : next_wp - 1;
+
+        m_c0[i] = m_map.x[prev_wp];
+        m_c1[i] = m_map.y[prev_wp];
+        m_c2[i] = m_nx[prev_wp];
+        m_c3[i] = m_ny[prev_wp];
+        m_c4[i] = m_nn[prev_wp];
+        m_c5[i] = m_cx[prev_wp];
+        m_c6[i] = m_cy[prev_wp];
+        m_c7[i] = m_map.arc_s[prev_wp];
+    }
+
+    size_t width = PackOps<FrenetIsa>::width;
+    size_t packed = n - n % width;
+    frenetKernel<FrenetIsa>(0, packed, xs, ys, s_out, d_out);
+    frenetKernel<ScalarIsa>(packed, n, xs, ys, s_out, d_out);
+}
+
+template <typename Isa>
+inline void FrenetBatch::frenetKernel(size_t begin, size_t end, const double *xs, const double *ys,
+                                      double *s_out, double *d_out) const
+{
+    typedef PackOps<Isa> V;
+    typedef typename V::pack P;
+    const P minus_one = V::set1(-1.0);
+    const P max_s = V::set1(m_map.max_s);
+
+    for(size_t i = begin; i < end; i += V::width)
+    {
+        P n_x = V::load(&m_c2[i]);
+        P n_y = V::load(&m_c3[i]);
+        P x_x = V::sub(V::load(&xs[i]), V::load(&m_c0[i]));
+        P x_y = V::sub(V::load(&ys[i]), V::load(&m_c1[i]));
+
+        // find the projection of x onto n
+        P proj_norm = V::div(V::add(V::mul(x_x, n_x), V::mul(x_y, n_y)), V::load(&m_c4[i]));
+        P proj_x = V::mul(proj_norm, n_x);
+        P proj_y = V::mul(proj_norm, n_y);
+
+        P ex = V::sub(proj_x, x_x);
+        P ey = V::sub(proj_y, x_y);
+        P frenet_d = V::sqrt(V::add(V::mul(ex, ex), V::mul(ey, ey)));
+
+        // sign of d from the distances to the center point
+        P center_x = V::load(&m_c5[i]);
+        P center_y = V::load(&m_c6[i]);
+        P px = V::sub(x_x, center_x);
+        P py = V::sub(x_y, center_y);
+        P rx = V::sub(proj_x, center_x);
+        P ry = V::sub(proj_y, center_y);
+        P centerToPos = V::sqrt(V::add(V::mul(px, px), V::mul(py, py)));
+        P centerToRef = V::sqrt(V::add(V::mul(rx, rx), V::mul(ry, ry)));
+        frenet_d = V::selectLe(centerToPos, centerToRef, V::mul(frenet_d, minus_one), frenet_d);
+
+        P frenet_s = V::add(V::load(&m_c7[i]), V::sqrt(V::add(V::mul(proj_x, proj_x), V::mul(proj_y, proj_y))));
+        frenet_s = V::selectLe(max_s, frenet_s, V::sub(frenet_s, max_s), frenet_s);
+
+        V::store(&s_out[i], frenet_s);
+        V::store(&d_out[i], frenet_d);
+    }
+}
+
+inline void FrenetBatch::toFrenet(FrenetProjector &projector, const int *ids, const double *xs, const double *ys,
+                                  size_t n, double *s_out, double *d_out)
+{
+    reserve(n);
+
+    // Scalar pass: the projector's warm-started search, then gather
+    for(size_t i = 0; i < n; i++)
+    {
+        int seg = projector.segment(ids[i], xs[i], ys[i]);
+
+        m_c0[i] = m_map.x[seg];
+        m_c1[i] = m_map.y[seg];
+        m_c2[i] = m_nx[seg];
+        m_c3[i] = m_ny[seg];
+        m_c4[i] = m_inv_len2[seg];
+        m_c5[i] = m_len[seg];
+        m_c6[i] = m_map.arc_s[seg];
+    }
+
+    size_t width = PackOps<FrenetIsa>::width;
+    size_t packed = n - n % width;
+    projectedKernel<FrenetIsa>(0, packed, xs, ys, s_out, d_out);
+    projectedKernel<ScalarIsa>(packed, n, xs, ys, s_out, d_out);
+}
+
+template <typename Isa>
+inline void FrenetBatch::projectedKernel(size_t begin, size_t end, const double *xs, const double *ys,
+                                         double *s_out, double *d_out) const
+{
+    typedef PackOps<Isa> V;
+    typedef typename V::pack P;
+    const P zero = V::set1(0.0);
+    const P max_s = V::set1(m_map.max_s);
+
+    for(size_t i = begin; i < end; i += V::width)
+    {
+        P n_x = V::load(&m_c2[i]);
+        P n_y = V::load(&m_c3[i]);
+        P len = V::load(&m_c5[i]);
+        P x_x = V::sub(V::load(&xs[i]), V::load(&m_c0[i]));
+        P x_y = V::sub(V::load(&ys[i]), V::load(&m_c1[i]));
+
+        // unclamped parameter along the segment, d positive to its right
+        P t = V::mul(V::add(V::mul(x_x, n_x), V::mul(x_y, n_y)), V::load(&m_c4[i]));
+        P frenet_d = V::div(V::sub(V::mul(n_y, x_x), V::mul(n_x, x_y)), len);
+
+        P frenet_s = V::add(V::load(&m_c6[i]), V::mul(t, len));
+        frenet_s = V::selectLe(max_s, frenet_s, V::sub(frenet_s, max_s),
+                               V::selectLt(frenet_s, zero, V::add(frenet_s, max_s), frenet_s));
+
+        V::store(&s_out[i], frenet_s);
+        V::store(&d_out[i], frenet_d);
+    }
+}
+
+inline void FrenetBatch::toCartesian(const double *ss, const double *ds, size_t n,
+                                     double *x_out, double *y_out, SegmentHint *hint)
+{
+    reserve(n);
+
+    // Scalar pass: wrap s, find the segment and gather its constants
+    for(size_t i = 0; i < n; i++)
+    {
+        double s = m_map.wrapS(ss[i]);
+        int prev_wp = m_map.segmentOf(s, hint);
+
+        m_c0[i] = m_map.x[prev_wp];
+        m_c1[i] = m_map.y[prev_wp];
+        m_c2[i] = s - m_map.arc_s[prev_wp];
+        m_c3[i] = m_cos[prev_wp];
+        m_c4[i] = m_sin[prev_wp];
+        m_c5[i] = m_perp_cos[prev_wp];
+        m_c6[i] = m_perp_sin[prev_wp];
+    }
+
+    size_t width = PackOps<FrenetIsa>::width;
+    size_t packed = n - n % width;
+    cartesianKernel<FrenetIsa>(0, packed, ds, x_out, y_out);
+    cartesianKernel<ScalarIsa>(packed, n, ds, x_out, y_out);
+}
+
+template <typename Isa>
+inline void FrenetBatch::cartesianKernel(size_t begin, size_t end, const double *ds,
+                                         double *x_out, double *y_out) const
+{
+    typedef PackOps<Isa> V;
+    typedef typename V::pack P;
+
+    for(size_t i = begin; i < end; i += V::width)
+    {
+        P seg_s = V::load(&m_c2[i]);
+        P d = V::load(&ds[i]);
+
+        P seg_x = V::add(V::load(&m_c0[i]), V::mul(seg_s, V::load(&m_c3[i])));
+        P seg_y = V::add(V::load(&m_c1[i]), V::mul(seg_s, V::load(&m_c4[i])));
+
+        V::store(&x_out[i], V::add(seg_x, V::mul(d, V::load(&m_c5[i]))));
+        V::store(&y_out[i], V::add(seg_y, V::mul(d, V::load(&m_c6[i]))));
+    }
+}
+
+#endif /* FRENET_BATCH_H */
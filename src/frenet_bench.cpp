@@ -0,0 +1,645 @@
+#include <chrono>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "highway_map.h"
+#include "frenet_projector.h"
+#include "frenet_batch.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// ClosestWaypoint, NextWaypoint and getFrenet as they were before the
+// index and the arc length table, s integrated over the waypoints up to
+// the segment on every call
+static int baselineClosest(const HighwayMap &map, double x, double y)
+{
+    double closestLen = 100000;
+    int closestWaypoint = 0;
+    for(size_t i = 0; i < map.x.size(); i++)
+    {
+        double dist = distance(x, y, map.x[i], map.y[i]);
+        if(dist < closestLen)
+        {
+            closestLen = dist;
+            closestWaypoint = i;
+        }
+    }
+    return closestWaypoint;
+}
+
+static int baselineNext(const HighwayMap &map, double x, double y, double theta)
+{
+    int closestWaypoint = baselineClosest(map, x, y);
+    double heading = atan2((map.y[closestWaypoint] - y), (map.x[closestWaypoint] - x));
+    double angle = fabs(theta - heading);
+    if(angle > pi() / 4)
+    {
+        closestWaypoint++;
+    }
+    return closestWaypoint;
+}
+
+// Also returns the integrated s of the segment start, what the table replaces
+static FrenetPoint baselineGetFrenet(const HighwayMap &map, double x, double y, double theta, int &prev_wp,
+                                     double &integrated)
+{
+    int next_wp = baselineNext(map, x, y, theta);
+    prev_wp = (next_wp == 0) ? map.x.size() - 1 : next_wp - 1;
+
+    double n_x = map.x[next_wp] - map.x[prev_wp];
+    double n_y = map.y[next_wp] - map.y[prev_wp];
+    double x_x = x - map.x[prev_wp];
+    double x_y = y - map.y[prev_wp];
+
+    double proj_norm = (x_x * n_x + x_y * n_y) / (n_x * n_x + n_y * n_y);
+    double proj_x = proj_norm * n_x;
+    double proj_y = proj_norm * n_y;
+
+    double frenet_d = distance(x_x, x_y, proj_x, proj_y);
+    double center_x = 1000 - map.x[prev_wp];
+    double center_y = 2000 - map.y[prev_wp];
+    double centerToPos = distance(center_x, center_y, x_x, x_y);
+    double centerToRef = distance(center_x, center_y, proj_x, proj_y);
+    if(centerToPos <= centerToRef)
+    {
+        frenet_d *= -1;
+    }
+
+    integrated = 0;
+    for(int i = 0; i < prev_wp; i++)
+    {
+        integrated += distance(map.x[i], map.y[i], map.x[i + 1], map.y[i + 1]);
+    }
+    return {integrated + distance(0, 0, proj_x, proj_y), frenet_d};
+}
+
+// getXY as it was before segmentOf, walking the segments from the first
+// on every call. The bounds test comes first here, the old code read one
+// past the table for s beyond the last waypoint
+static XY baselineGetXY(const HighwayMap &map, double s, double d)
+{
+    int prev_wp = -1;
+    while((prev_wp < (int)(map.arc_s.size() - 1)) && (s > map.arc_s[prev_wp + 1]))
+    {
+        prev_wp++;
+    }
+    int wp2 = (prev_wp + 1) % map.x.size();
+
+    double heading = atan2((map.y[wp2] - map.y[prev_wp]), (map.x[wp2] - map.x[prev_wp]));
+    double seg_s = (s - map.arc_s[prev_wp]);
+    double seg_x = map.x[prev_wp] + seg_s * cos(heading);
+    double seg_y = map.y[prev_wp] + seg_s * sin(heading);
+    double perp_heading = heading - pi() / 2;
+    return {seg_x + d * cos(perp_heading), seg_y + d * sin(perp_heading)};
+}
+
+// Runs one sequence of s through segmentOf with a hint, which must land on
+// the same segment as the binary search for every query
+static int hintMismatches(const HighwayMap &map, const vector<double> &sequence)
+{
+    SegmentHint hint;
+    int mismatches = 0;
+    for(double s : sequence)
+    {
+        double wrapped = map.wrapS(s);
+        if(map.segmentOf(wrapped, &hint) != map.segmentOf(wrapped))
+        {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// Projection onto the nearest of all segments, computed the way
+// FrenetProjector computes it, so the two agree bit for bit when they
+// pick the same segment. With nearest_wp only the two segments touching
+// the nearest waypoint are tried, the projector's old global search
+static FrenetPoint bruteForceFrenet(const HighwayMap &map, double x, double y, bool nearest_wp = false)
+{
+    int n = map.x.size();
+    int best = 0;
+    double best_d2 = numeric_limits<double>::infinity();
+    int closest = nearest_wp ? map.index.nearest(x, y) : 0;
+    for(int i = 0; i < (nearest_wp ? 2 : n); i++)
+    {
+        int k = nearest_wp ? (closest + n - 1 + i) % n : i;
+        int next = (k + 1) % n;
+        double nx = map.x[next] - map.x[k], ny = map.y[next] - map.y[k];
+        double len = sqrt(nx * nx + ny * ny);
+        double t = ((x - map.x[k]) * nx + (y - map.y[k]) * ny) * (1.0 / (len * len));
+        double clamped = min(max(t, 0.0), 1.0);
+        double e_x = (x - map.x[k]) - clamped * nx;
+        double e_y = (y - map.y[k]) - clamped * ny;
+        double d2 = e_x * e_x + e_y * e_y;
+        if(d2 < best_d2)
+        {
+            best_d2 = d2;
+            best = k;
+        }
+    }
+
+    int k = best, next = (k + 1) % n;
+    double nx = map.x[next] - map.x[k], ny = map.y[next] - map.y[k];
+    double len = sqrt(nx * nx + ny * ny);
+    double x_x = x - map.x[k], x_y = y - map.y[k];
+    double t = (x_x * nx + x_y * ny) * (1.0 / (len * len));
+    double frenet_s = map.arc_s[k] + t * len;
+    if(frenet_s >= map.max_s)
+    {
+        frenet_s -= map.max_s;
+    }
+    else if(frenet_s < 0)
+    {
+        frenet_s += map.max_s;
+    }
+    return {frenet_s, (ny * x_x - nx * x_y) / len};
+}
+
+// Writes a loop whose two straights run 6 m apart, joined by 3 m hairpins,
+// with segments alternating between 2 m and 40 m. The nearest waypoint is
+// often not on the nearest segment there
+static bool writeTightMap(const string &path)
+{
+    ofstream out(path.c_str());
+    vector<double> xs, ys;
+    for(int side = 0; side < 2; side++)
+    {
+        double dir = side ? -1 : 1;
+        double x0 = side ? 294 : 0, y0 = side ? 6 : 0;
+        for(double along = 0, step = 2; along < 294; along += step, step = (step == 2) ? 40 : 2)
+        {
+            xs.push_back(x0 + dir * along);
+            ys.push_back(y0);
+        }
+        double cx = side ? 0 : 294;
+        for(int i = 0; i < 8; i++)
+        {
+            double a = -pi() / 2 + pi() * i / 8;
+            xs.push_back(cx + dir * 3 * cos(a));
+            ys.push_back(3 + dir * 3 * sin(a));
+        }
+    }
+    double s = 0;
+    for(size_t i = 0; i < xs.size(); i++)
+    {
+        size_t next = (i + 1) % xs.size();
+        double len = distance(xs[i], ys[i], xs[next], ys[next]);
+        out << xs[i] << " " << ys[i] << " " << s << " " << (ys[next] - ys[i]) / len << " "
+            << -(xs[next] - xs[i]) / len << "\n";
+        s += len;
+    }
+    return (bool)out;
+}
+
+// Projects points around the road through FrenetProjector, untracked so
+// the global search runs every time and tracked along lanes at 0.44 m
+// steps, and with the nearest waypoint search alone, against the brute
+// force projection
+static void checkProjector(const HighwayMap &map, double d_lo, double d_hi, int queries, int &compared,
+                           int &mismatches, int &nearest_wp_mismatches)
+{
+    FrenetProjector projector(map);
+    mt19937 random(2);
+    uniform_real_distribution<double> along(0, map.max_s);
+    uniform_real_distribution<double> across(d_lo, d_hi);
+
+    for(int i = 0; i < queries; i++)
+    {
+        XY q = getXY(along(random), across(random), map);
+        FrenetPoint truth = bruteForceFrenet(map, q.x, q.y);
+        projector.forget(0);
+        FrenetPoint fresh = projector.project(0, q.x, q.y);
+        FrenetPoint old = bruteForceFrenet(map, q.x, q.y, true);
+        mismatches += (fresh.s != truth.s || fresh.d != truth.d);
+        nearest_wp_mismatches += (old.s != truth.s || old.d != truth.d);
+        compared++;
+    }
+
+    for(int lane = 0; lane < 3; lane++)
+    {
+        double d = d_lo + (d_hi - d_lo) * (lane + 0.5) / 3;
+        SegmentHint hint;
+        for(double s = 0; s < map.max_s; s += 0.44)
+        {
+            XY q = getXY(s, d, map, &hint);
+            FrenetPoint truth = bruteForceFrenet(map, q.x, q.y);
+            FrenetPoint tracked = projector.project(1 + lane, q.x, q.y);
+            mismatches += (tracked.s != truth.s || tracked.d != truth.d);
+            compared++;
+        }
+    }
+}
+
+/****************************************************************/
+/* Checks the arc length table getFrenet reads its s from against the
+ * waypoints: increasing, within the 5 cm tolerance of the integrated
+ * geometry, and closing the loop at max_s. Then converts points all
+ * over the road with getFrenet and with the integrating getFrenet it
+ * replaced, which must agree bit for bit in d and differ in s by just
+ * the table's offset from the integral, modulo max_s, and times both.
+ * Points whose next waypoint is past the last one are skipped, the old
+ * code read beyond the map there.
+ * Then checks the s side: wrapS on laps forward and back, segmentOf
+ * with a hint against the binary search on monotone, backward, jumping
+ * and lap-crossing sequences, so the hint's 4 step walk and its fallback
+ * both run, and getXY against the segment walk it replaced, which must
+ * agree bit for bit.
+ * Last, FrenetProjector against the brute force projection onto every
+ * segment, on the map and on a generated tight, uneven loop where the
+ * nearest segment often does not touch the nearest waypoint, and times
+ * its tracked and global searches.
+ * And FrenetBatch, built for the widest of AVX, SSE2 or scalar code the
+ * compiler targets, against getFrenet, FrenetProjector and getXY one
+ * element at a time, bit for bit, with its throughput in conversions per
+ * second at the batch sizes of a sensor_fusion list and larger. Fails on
+ * any mismatch:
+ * frenet_bench [map.csv] [queries] */
+/****************************************************************/
+int main(int argc, char *argv[])
+{
+    string map_file_ = (argc > 1) ? argv[1] : "../data/highway_map.csv";
+    int queries = (argc > 2) ? atoi(argv[2]) : 200000;
+
+    HighwayMap map;
+    if(!map.loadCsv(map_file_))
+    {
+        cerr << "Failed to read waypoints from " << map_file_ << endl;
+        return -1;
+    }
+    map.buildIndex();
+    int n = map.x.size();
+
+    // Arc length table
+    bool table_ok = (map.arc_s[0] == 0);
+    double worst_table = 0, worst_column = 0;
+    for(int i = 1; i < n; i++)
+    {
+        table_ok = table_ok && (map.arc_s[i] > map.arc_s[i - 1]);
+        worst_table = max(worst_table, fabs(map.arc_s[i] - (map.arc_s[i - 1] + distance(map.x[i - 1], map.y[i - 1],
+                                                                                          map.x[i], map.y[i]))));
+        worst_column = max(worst_column, fabs(map.arc_s[i] - map.s[i]));
+    }
+    double closing = map.arc_s[n - 1] + distance(map.x[n - 1], map.y[n - 1], map.x[0], map.y[0]);
+    table_ok = table_ok && worst_table <= 0.05 && fabs(map.max_s - closing) <= 0.05;
+
+    // Points anywhere on the road and a lane beyond, heading along it give or take
+    mt19937 random(1);
+    uniform_real_distribution<double> along(0, map.max_s);
+    uniform_real_distribution<double> across(-4, 16);
+    uniform_real_distribution<double> yaw(-0.3, 0.3);
+    vector<double> qx(queries), qy(queries), qtheta(queries);
+    for(int i = 0; i < queries; i++)
+    {
+        double s = along(random);
+        int wp = map.segmentOf(s);
+        int next = (wp + 1) % n;
+        XY q = getXY(s, across(random), map);
+        qx[i] = q.x;
+        qy[i] = q.y;
+        qtheta[i] = atan2(map.y[next] - map.y[wp], map.x[next] - map.x[wp]) + yaw(random);
+    }
+
+    int compared = 0, skipped = 0, mismatches = 0;
+    double worst_s = 0;
+    for(int i = 0; i < queries; i++)
+    {
+        if(baselineNext(map, qx[i], qy[i], qtheta[i]) == n)
+        {
+            skipped++;
+            continue;
+        }
+        int prev_wp;
+        double integrated;
+        FrenetPoint old = baselineGetFrenet(map, qx[i], qy[i], qtheta[i], prev_wp, integrated);
+        FrenetPoint now = getFrenet(qx[i], qy[i], qtheta[i], map);
+
+        // The s the table gives for the same projection, wrapped like getFrenet
+        double expected = old.s - integrated + map.arc_s[prev_wp];
+        double ds = fabs(map.wrapS(now.s) - map.wrapS(expected));
+        ds = min(ds, map.max_s - ds);
+        worst_s = max(worst_s, ds);
+        if(now.d != old.d || ds > 1e-9 || now.s < 0 || now.s >= map.max_s)
+        {
+            mismatches++;
+        }
+        compared++;
+    }
+
+    double sink = 0;
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < queries; i++)
+    {
+        int prev_wp;
+        double integrated;
+        sink += baselineGetFrenet(map, qx[i], qy[i], qtheta[i], prev_wp, integrated).s;
+    }
+    double baseline_ns = chrono::duration<double, nano>(Clock::now() - start).count() / queries;
+
+    start = Clock::now();
+    for(int i = 0; i < queries; i++)
+    {
+        sink += getFrenet(qx[i], qy[i], qtheta[i], map).s;
+    }
+    double frenet_ns = chrono::duration<double, nano>(Clock::now() - start).count() / queries;
+
+    // wrapS, any lap forward or back lands on the same s
+    int wrap_mismatches = 0;
+    for(int i = 0; i < queries; i += 97)
+    {
+        double s = along(random);
+        for(int lap = -3; lap <= 3; lap++)
+        {
+            double wrapped = map.wrapS(s + lap * map.max_s);
+            if(wrapped < 0 || wrapped >= map.max_s || fabs(wrapped - s) > 1e-9)
+            {
+                wrap_mismatches++;
+            }
+        }
+    }
+
+    // segmentOf with a hint: 0.4 m ticks forward over two laps, backward over
+    // one, jumps of 1 to 20 segments either way, and uniform random s
+    vector<vector<double> > sequences(4);
+    for(double s = 0; s < 2 * map.max_s; s += 0.4)
+    {
+        sequences[0].push_back(s);
+    }
+    for(double s = map.max_s; s > -0.4; s -= 0.4)
+    {
+        sequences[1].push_back(s);
+    }
+    uniform_int_distribution<int> jump(-20, 20);
+    double seg_len = map.max_s / n;
+    double js = 0;
+    for(int i = 0; i < queries / 10; i++)
+    {
+        js += jump(random) * seg_len + yaw(random);
+        sequences[2].push_back(js);
+    }
+    for(int i = 0; i < queries / 10; i++)
+    {
+        sequences[3].push_back(along(random));
+    }
+    int hint_mismatches = 0;
+    for(const vector<double> &sequence : sequences)
+    {
+        hint_mismatches += hintMismatches(map, sequence);
+    }
+    // Exactly on the waypoints, where the two searches could disagree by one
+    vector<double> knots(map.arc_s.begin(), map.arc_s.end());
+    knots.push_back(map.max_s);
+    hint_mismatches += hintMismatches(map, knots);
+
+    // getXY against the segment walk on (0, max_s)
+    vector<double> ps(queries), pd(queries);
+    for(int i = 0; i < queries; i++)
+    {
+        ps[i] = along(random);
+        pd[i] = across(random);
+    }
+    int xy_mismatches = 0;
+    for(int i = 0; i < queries; i++)
+    {
+        if(ps[i] <= 0)
+        {
+            continue;
+        }
+        XY old = baselineGetXY(map, ps[i], pd[i]);
+        XY now = getXY(ps[i], pd[i], map);
+        if(old.x != now.x || old.y != now.y)
+        {
+            xy_mismatches++;
+        }
+    }
+
+    // Timing on a monotone sweep, the planner's access pattern
+    vector<double> sweep(sequences[0].begin(), sequences[0].end());
+    int sweeps = max(1, queries / (int)sweep.size());
+    start = Clock::now();
+    for(int k = 0; k < sweeps; k++)
+    {
+        for(double s : sweep)
+        {
+            sink += baselineGetXY(map, map.wrapS(s), 2).x;
+        }
+    }
+    double walk_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (sweeps * sweep.size());
+
+    start = Clock::now();
+    for(int k = 0; k < sweeps; k++)
+    {
+        for(double s : sweep)
+        {
+            sink += getXY(s, 2, map).x;
+        }
+    }
+    double binary_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (sweeps * sweep.size());
+
+    start = Clock::now();
+    for(int k = 0; k < sweeps; k++)
+    {
+        SegmentHint hint;
+        for(double s : sweep)
+        {
+            sink += getXY(s, 2, map, &hint).x;
+        }
+    }
+    double hint_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (sweeps * sweep.size());
+
+    // FrenetProjector, on the map and on the tight loop
+    int projected = 0, projector_mismatches = 0, map_nearest_wp = 0, tight_nearest_wp = 0;
+    checkProjector(map, -4, 16, queries / 10, projected, projector_mismatches, map_nearest_wp);
+    HighwayMap tight;
+    const string tight_file_ = "frenet_bench_tight.csv";
+    if(!writeTightMap(tight_file_) || !tight.loadCsv(tight_file_))
+    {
+        cerr << "Failed to write the tight map to " << tight_file_ << endl;
+        return -1;
+    }
+    tight.buildIndex();
+    checkProjector(tight, -2.5, 2.5, queries / 10, projected, projector_mismatches, tight_nearest_wp);
+    remove(tight_file_.c_str());
+
+    FrenetProjector projector(map);
+    start = Clock::now();
+    for(int k = 0; k < sweeps; k++)
+    {
+        for(double s : sweep)
+        {
+            XY q = getXY(s, 6, map);
+            sink += projector.project(0, q.x, q.y).s;
+        }
+    }
+    double tracked_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (sweeps * sweep.size());
+    start = Clock::now();
+    for(int i = 0; i < queries; i++)
+    {
+        projector.forget(0);
+        sink += projector.project(0, qx[i], qy[i]).s;
+    }
+    double global_ns = chrono::duration<double, nano>(Clock::now() - start).count() / queries;
+
+    // FrenetBatch against the scalar conversions, in batches of every size
+    // from 1 to 9 so that every packed width and tail is hit, then of 64
+    FrenetBatch batch(map);
+    FrenetProjector scalar_projector(map), batch_projector(map);
+    vector<int> ids(queries);
+    vector<double> s_out(queries), d_out(queries), x_out(queries), y_out(queries);
+    for(int i = 0; i < queries; i++)
+    {
+        ids[i] = i % 64;
+    }
+    int batch_mismatches = 0;
+    for(int mode = 0; mode < 3; mode++)
+    {
+        SegmentHint hint;
+        for(int begin = 0, size = 1; begin < queries; begin += size, size = (size < 9) ? size + 1 : 64)
+        {
+            int count = min(size, queries - begin);
+            if(mode == 0)
+            {
+                batch.toFrenet(&qx[begin], &qy[begin], &qtheta[begin], count, &s_out[begin], &d_out[begin]);
+            }
+            else if(mode == 1)
+            {
+                batch.toFrenet(batch_projector, &ids[begin], &qx[begin], &qy[begin], count, &s_out[begin],
+                               &d_out[begin]);
+            }
+            else
+            {
+                batch.toCartesian(&ps[begin], &pd[begin], count, &x_out[begin], &y_out[begin], &hint);
+            }
+        }
+        for(int i = 0; i < queries; i++)
+        {
+            if(mode == 0)
+            {
+                FrenetPoint p = getFrenet(qx[i], qy[i], qtheta[i], map);
+                batch_mismatches += (p.s != s_out[i] || p.d != d_out[i]);
+            }
+            else if(mode == 1)
+            {
+                FrenetPoint p = scalar_projector.project(ids[i], qx[i], qy[i]);
+                batch_mismatches += (p.s != s_out[i] || p.d != d_out[i]);
+            }
+            else
+            {
+                XY p = getXY(ps[i], pd[i], map);
+                batch_mismatches += (p.x != x_out[i] || p.y != y_out[i]);
+            }
+        }
+    }
+
+    // Conversions per second, scalar and batched at each batch size, the
+    // projected ones tracking 64 vehicles along a sweep. One extra batch
+    // warms the scratch up
+    const int batch_sizes[] = {12, 64, 1024};
+    vector<double> sweep_x, sweep_y;
+    vector<int> sweep_id;
+    for(size_t i = 0; i < sweep.size() && (int)sweep_x.size() < queries; i++)
+    {
+        for(int lane = 0; lane < 64; lane++)
+        {
+            XY q = getXY(sweep[i] + lane * 100, 2 + 4 * (lane % 3), map);
+            sweep_x.push_back(q.x);
+            sweep_y.push_back(q.y);
+            sweep_id.push_back(lane);
+        }
+    }
+    int sweep_count = sweep_x.size();
+    double scalar_rate[3], batch_rate[3][3];
+    for(int mode = 0; mode < 3; mode++)
+    {
+        FrenetProjector projector(map);
+        projector.reserve(64);
+        start = Clock::now();
+        for(int i = 0; i < queries; i++)
+        {
+            if(mode == 0)
+            {
+                sink += getFrenet(qx[i], qy[i], qtheta[i], map).s;
+            }
+            else if(mode == 1)
+            {
+                sink += projector.project(sweep_id[i % sweep_count], sweep_x[i % sweep_count],
+                                          sweep_y[i % sweep_count]).s;
+            }
+            else
+            {
+                sink += getXY(ps[i], pd[i], map).x;
+            }
+        }
+        scalar_rate[mode] = queries / chrono::duration<double>(Clock::now() - start).count();
+
+        for(int b = 0; b < 3; b++)
+        {
+            int size = batch_sizes[b];
+            int rounds = max(1, queries / size);
+            FrenetBatch timed(map);
+            FrenetProjector timed_projector(map);
+            timed_projector.reserve(64);
+            timed.reserve(size);
+            start = Clock::now();
+            for(int r = 0; r < rounds; r++)
+            {
+                int begin = (r * size) % (queries - size + 1);
+                if(mode == 0)
+                {
+                    timed.toFrenet(&qx[begin], &qy[begin], &qtheta[begin], size, &s_out[0], &d_out[0]);
+                }
+                else if(mode == 1)
+                {
+                    // Whole lists of 64 vehicles in order, so each id moves on a little every batch
+                    int from = (r * size) % (sweep_count - size + 1);
+                    from -= from % 64;
+                    timed.toFrenet(timed_projector, &sweep_id[from], &sweep_x[from], &sweep_y[from], size,
+                                   &s_out[0], &d_out[0]);
+                }
+                else
+                {
+                    timed.toCartesian(&ps[begin], &pd[begin], size, &x_out[0], &y_out[0]);
+                }
+                sink += s_out[0] + x_out[0];
+            }
+            batch_rate[mode][b] = (double)rounds * size / chrono::duration<double>(Clock::now() - start).count();
+        }
+    }
+
+    bool ok = table_ok && mismatches == 0 && wrap_mismatches == 0 && hint_mismatches == 0 && xy_mismatches == 0
+              && projector_mismatches == 0 && batch_mismatches == 0;
+    cout << n << " waypoints, max_s " << map.max_s << ", arc_s off the integrated segment lengths by at most "
+         << worst_table << " m, off the s column by at most " << worst_column << " m"
+         << (table_ok ? "" : " (table inconsistent)") << endl;
+    cout << "getFrenet against the integrating getFrenet: " << compared << " compared, " << skipped
+         << " past the last waypoint skipped, " << mismatches << " differ, worst s difference " << worst_s
+         << " m" << endl;
+    cout << "getFrenet " << frenet_ns << " ns/query, integrating " << baseline_ns << " ns/query "
+         << baseline_ns / frenet_ns << "x" << endl;
+    cout << "wrapS over 7 laps: " << wrap_mismatches << " differ; segmentOf with a hint against the binary search: "
+         << hint_mismatches << " differ; getXY against the segment walk: " << xy_mismatches << " differ" << endl;
+    cout << "getXY on a sweep: walk " << walk_ns << " ns/query, binary search " << binary_ns << " ns/query, hint "
+         << hint_ns << " ns/query" << endl;
+    cout << "FrenetProjector against the brute force projection: " << projected << " compared, "
+         << projector_mismatches << " differ; segments at the nearest waypoint alone differ " << map_nearest_wp
+         << " times on the map, " << tight_nearest_wp << " on the tight loop" << endl;
+    cout << "FrenetProjector tracked on a sweep, getXY included, " << tracked_ns << " ns/query, untracked on the "
+         << "getFrenet points " << global_ns << " ns/query" << endl;
+    cout << "FrenetBatch, " << PackOps<FrenetIsa>::width << " doubles per pack, against getFrenet, "
+         << "FrenetProjector and getXY: " << 3 * queries << " compared, " << batch_mismatches << " differ" << endl;
+    const char *mode_names[3] = {"getFrenet  ", "projected  ", "toCartesian"};
+    for(int mode = 0; mode < 3; mode++)
+    {
+        printf("%s M conversions/s: scalar %7.2f, batches of %d %7.2f, %d %7.2f, %d %7.2f\n", mode_names[mode],
+               scalar_rate[mode] / 1e6, batch_sizes[0], batch_rate[mode][0] / 1e6, batch_sizes[1],
+               batch_rate[mode][1] / 1e6, batch_sizes[2], batch_rate[mode][2] / 1e6);
+    }
+    cout << (sink == 0 ? " " : "");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+#ifndef FRENET_PROJECTOR_H
+#define FRENET_PROJECTOR_H
+
+#include <math.h>
+#include <vector>
+#include "highway_map.h"
+
+/****************************************************************/
+/* Warm-started Cartesian to Frenet projection. Remembers the segment
+ * each tracked vehicle was last projected onto and first searches the
+ * segments around it, which is O(1) while vehicles move a few meters
+ * per tick. Only when that local search fails does it fall back to
+ * the global waypoint index, which finds the nearest segment exactly.
+ * The segment is picked as the nearest one geometrically, so no heading
+ * is needed and there is no angle heuristic to jump to a wrong segment */
+/****************************************************************/
+class FrenetProjector
+{
+public:
+    // Id of the ego vehicle, sensor_fusion ids are used as they come
+    static const int egoId = -1;
+
+    explicit FrenetProjector(const HighwayMap &map);
+
+    // Frenet s,d of the vehicle with the given id at x,y
+    FrenetPoint project(int id, double x, double y);
+    // Just the segment project() would use, remembered for the id the same way
+    int segment(int id, double x, double y);
+
+    // Keeps ids 0 .. ids - 1 and the ego from allocating on first use
+    void reserve(int ids);
+
+    // Drops the remembered segment, e.g. when a vehicle leaves sensor range
+    void forget(int id);
+
+private:
+    // Segments searched on each side of the remembered one
+    static const int window = 2;
+
+    // Squared distance from x,y to segment k, and the unclamped projection
+    // parameter along it
+    double segmentDist2(int k, double x, double y, double &t) const;
+    // Nearest segment among k - window .. k + window, false when the nearest
+    // one is at the edge of the window and a better one may lie beyond it
+    bool searchLocal(int k, double x, double y, int &best) const;
+    int searchGlobal(double x, double y) const;
+
+    int &slot(int id);
+
+    const HighwayMap &m_map;
+    std::vector<double> m_nx, m_ny, m_len, m_inv_len2;   // per segment
+    double m_max_half_len = 0;                           // of the longest segment
+    std::vector<int> m_last;                             // per id + 1, -1 if unknown
+};
+
+inline FrenetProjector::FrenetProjector(const HighwayMap &map) : m_map(map)
+{
+    int n = map.x.size();
+    m_nx.resize(n); m_ny.resize(n); m_len.resize(n); m_inv_len2.resize(n);
+    for(int k = 0; k < n; k++)
+    {
+        int next = (k + 1) % n;
+        m_nx[k] = map.x[next] - map.x[k];
+        m_ny[k] = map.y[next] - map.y[k];
+        m_len[k] = sqrt(m_nx[k] * m_nx[k] + m_ny[k] * m_ny[k]);
+        m_inv_len2[k] = 1.0 / (m_len[k] * m_len[k]);
+        m_max_half_len = std::max(m_max_half_len, m_len[k] / 2);
+    }
+}
+
+inline int &FrenetProjector::slot(int id)
+{
+    size_t i = id + 1;
+    if(i >= m_last.size())
+    {
+        m_last.resize(i + 1, -1);
+    }
+    return m_last[i];
+}
+
+inline void FrenetProjector::reserve(int ids)
+{
+    if(m_last.size() < (size_t)ids + 1)
+    {
+        m_last.resize(ids + 1, -1);
+    }
+}
+
+inline void FrenetProjector::forget(int id)
+{
+    if((size_t)(id + 1) < m_last.size())
+    {
+        m_last[id + 1] = -1;
+    }
+}
+
+inline double FrenetProjector::segmentDist2(int k, double x, double y, double &t) const
+{
+    double x_x = x - m_map.x[k];
+    double x_y = y - m_map.y[k];
+    t = (x_x * m_nx[k] + x_y * m_ny[k]) * m_inv_len2[k];
+
+    double clamped = std::min(std::max(t, 0.0), 1.0);
+    double e_x = x_x - clamped * m_nx[k];
+    double e_y = x_y - clamped * m_ny[k];
+    return e_x * e_x + e_y * e_y;
+}
+
+inline bool FrenetProjector::searchLocal(int k, double x, double y, int &best) const
+{
+    int n = m_nx.size();
+    double best_d2 = std::numeric_limits<double>::infinity();
+    int best_offset = 0;
+    for(int offset = -window; offset <= window; offset++)
+    {
+        int seg = ((k + offset) % n + n) % n;
+        double t;
+        double d2 = segmentDist2(seg, x, y, t);
+        if(d2 < best_d2)
+        {
+            best_d2 = d2;
+            best = seg;
+            best_offset = offset;
+        }
+    }
+    return (best_offset > -window) && (best_offset < window);
+}
+
+inline int FrenetProjector::searchGlobal(double x, double y) const
+{
+    // The segments at the nearest waypoint give a first candidate, but on
+    // uneven or tight maps the nearest segment need not touch it. The foot
+    // of x,y on any segment lies within half its length of an endpoint, so
+    // a segment nearer than the candidate has an endpoint within
+    // sqrt(best_d2 + max_half_len^2), and only the segments touching those
+    // waypoints are compared
+    int n = m_nx.size();
+    int closest = ClosestWaypoint(x, y, m_map);
+    int best = closest;
+    double t;
+    double best_d2 = segmentDist2(closest, x, y, t);
+    int before = (closest + n - 1) % n;
+    double d2 = segmentDist2(before, x, y, t);
+    if(d2 < best_d2)
+    {
+        best_d2 = d2;
+        best = before;
+    }
+
+    double radius = sqrt(best_d2 + m_max_half_len * m_max_half_len) * (1 + 1e-9) + 1e-9;
+    m_map.index.within(x, y, radius, [&](int wp) {
+        int touching[2] = {(wp + n - 1) % n, wp};
+        for(int seg : touching)
+        {
+            double d2 = segmentDist2(seg, x, y, t);
+            if(d2 < best_d2 || (d2 == best_d2 && seg < best))
+            {
+                best_d2 = d2;
+                best = seg;
+            }
+        }
+    });
+    return best;
+}
+
+inline int FrenetProjector::segment(int id, double x, double y)
+{
+    int &last = slot(id);
+
+    int seg = -1;
+    if(last < 0 || !searchLocal(last, x, y, seg))
+    {
+        seg = searchGlobal(x, y);
+    }
+    last = seg;
+    return seg;
+}
+
+inline FrenetPoint FrenetProjector::project(int id, double x, double y)
+{
+    int seg = segment(id, x, y);
+
+    double t;
+    segmentDist2(seg, x, y, t);
+
+    // d is positive to the right of the direction of travel
+    double x_x = x - m_map.x[seg];
+    double x_y = y - m_map.y[seg];
+    double frenet_d = (m_ny[seg] * x_x - m_nx[seg] * x_y) / m_len[seg];
+
+    double frenet_s = m_map.arc_s[seg] + t * m_len[seg];
+    if(frenet_s >= m_map.max_s)
+    {
+        frenet_s -= m_map.max_s;
+    }
+    else if(frenet_s < 0)
+    {
+        frenet_s += m_map.max_s;
+    }
+
+    return {frenet_s, frenet_d};
+}
+
+#endif /* FRENET_PROJECTOR_H */
@@ -0,0 +1,534 @@
+#ifndef HIGHWAY_MAP_H
+#define HIGHWAY_MAP_H
+
+#include <math.h>
+#include <algorithm>
+#include <stdint.h>
+#include <cstddef>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// For converting back and forth between radians and degrees.
+constexpr double pi() { return M_PI; }
+
+/****************************************************************/
+/* Plain point types returned by the coordinate transforms, so a
+ * conversion never touches the heap */
+/****************************************************************/
+struct XY
+{
+    double x;
+    double y;
+};
+
+struct FrenetPoint
+{
+    double s;
+    double d;
+};
+
+/****************************************************************/
+/* Read-only view of a contiguous array. The map data is read through
+ * these so it can live either in vectors owned by the map or directly
+ * in a memory-mapped map file */
+/****************************************************************/
+template <typename T>
+class ConstArray
+{
+public:
+    ConstArray() : m_data(nullptr), m_size(0) {}
+    ConstArray(const T *data, size_t size) : m_data(data), m_size(size) {}
+    ConstArray(const std::vector<T> &v) : m_data(v.data()), m_size(v.size()) {}
+
+    const T &operator[](size_t i) const { return m_data[i]; }
+    const T *data() const { return m_data; }
+    const T *begin() const { return m_data; }
+    const T *end() const { return m_data + m_size; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    const T *m_data;
+    size_t m_size;
+};
+
+/****************************************************************/
+/* Spatial index over the map waypoints, a bounding hierarchy over
+ * ranges of consecutive waypoints stored implicitly in a flat array:
+ * the range [lo, hi) is split at mid = (lo + hi) / 2 and keeps at mid
+ * the radius of the capsule around the chord from its first to its
+ * last waypoint that holds all of them. Consecutive waypoints follow
+ * the road, so the capsules are thin and a query near the road only
+ * opens the few ranges passing close to it, O(log n) however densely
+ * the map is sampled. Leaves of up to leafSize waypoints are scanned.
+ * The waypoints are read in place and must outlive the index */
+/****************************************************************/
+class WaypointIndex
+{
+public:
+    void build(ConstArray<double> xs, ConstArray<double> ys);
+
+    // Uses capsule radii computed earlier, e.g. stored in a map file
+    void attach(ConstArray<double> xs, ConstArray<double> ys, ConstArray<double> radius);
+
+    // Index of the closest waypoint, ties resolved to the lowest index
+    // like the linear scan it replaces
+    int nearest(double x, double y) const;
+
+    // Calls visit(i) for every waypoint i within radius of x,y, in no
+    // particular order
+    template <typename Visit>
+    void within(double x, double y, double radius, Visit visit) const;
+
+    bool empty() const { return m_x.empty(); }
+
+    // Capsule radius of every range by its mid, for writing them out
+    ConstArray<double> radius() const { return m_radius; }
+
+private:
+    static const int leafSize = 8;
+
+    void buildRange(int lo, int hi);
+    // Distance from (x, y) to the chord of [lo, hi), squared
+    double chordDistance2(int lo, int hi, double x, double y) const;
+    void searchRange(int lo, int hi, double x, double y, int &best, double &best_d2) const;
+    template <typename Visit>
+    void withinRange(int lo, int hi, double x, double y, double radius, Visit &visit) const;
+
+    ConstArray<double> m_x;
+    ConstArray<double> m_y;
+    ConstArray<double> m_radius;
+
+    // Backing storage when the radii were computed rather than attached
+    std::vector<double> m_radius_store;
+};
+
+inline void WaypointIndex::build(ConstArray<double> xs, ConstArray<double> ys)
+{
+    m_x = xs;
+    m_y = ys;
+    m_radius_store.assign(xs.size(), 0);
+    buildRange(0, xs.size());
+    m_radius = m_radius_store;
+}
+
+inline void WaypointIndex::attach(ConstArray<double> xs, ConstArray<double> ys, ConstArray<double> radius)
+{
+    m_x = xs;
+    m_y = ys;
+    m_radius = radius;
+}
+
+inline void WaypointIndex::buildRange(int lo, int hi)
+{
+    if(hi - lo < 2)
+    {
+        return;
+    }
+
+    double radius2 = 0;
+    for(int i = lo + 1; i < hi - 1; i++)
+    {
+        radius2 = std::max(radius2, chordDistance2(lo, hi, m_x[i], m_y[i]));
+    }
+    // Rounded up a little, so the bound stays a bound despite rounding
+    m_radius_store[(lo + hi) / 2] = sqrt(radius2) * (1 + 1e-9) + 1e-9;
+
+    if(hi - lo > leafSize)
+    {
+        int mid = (lo + hi) / 2;
+        buildRange(lo, mid);
+        buildRange(mid, hi);
+    }
+}
+
+inline double WaypointIndex::chordDistance2(int lo, int hi, double x, double y) const
+{
+    double ax = m_x[lo], ay = m_y[lo];
+    double ex = m_x[hi - 1] - ax, ey = m_y[hi - 1] - ay;
+    double length2 = ex * ex + ey * ey;
+    double t = (length2 > 0) ? ((x - ax) * ex + (y - ay) * ey) / length2 : 0;
+    t = std::min(std::max(t, 0.0), 1.0);
+    double dx = x - (ax + t * ex);
+    double dy = y - (ay + t * ey);
+    return dx * dx + dy * dy;
+}
+
+inline int WaypointIndex::nearest(double x, double y) const
+{
+    int best = 0;
+    double best_d2 = std::numeric_limits<double>::infinity();
+    searchRange(0, m_x.size(), x, y, best, best_d2);
+    return best;
+}
+
+inline void WaypointIndex::searchRange(int lo, int hi, double x, double y, int &best, double &best_d2) const
+{
+    if(hi - lo <= leafSize)
+    {
+        for(int i = lo; i < hi; i++)
+        {
+            double dx = x - m_x[i];
+            double dy = y - m_y[i];
+            double d2 = dx * dx + dy * dy;
+            if((d2 < best_d2) || ((d2 == best_d2) && (i < best)))
+            {
+                best_d2 = d2;
+                best = i;
+            }
+        }
+        return;
+    }
+
+    // Nearer chord first, the other half only if its capsule can still
+    // hold a waypoint as close: distance to the chord within radius plus
+    // best distance. Equal distances are visited to keep the lowest-index
+    // tie break
+    int mid = (lo + hi) / 2;
+    double chord_lo = chordDistance2(lo, mid, x, y);
+    double chord_hi = chordDistance2(mid, hi, x, y);
+    bool lo_first = chord_lo <= chord_hi;
+    for(int half = 0; half < 2; half++)
+    {
+        bool take_lo = (half == 0) == lo_first;
+        int range_lo = take_lo ? lo : mid;
+        int range_hi = take_lo ? mid : hi;
+        double reach = m_radius[(range_lo + range_hi) / 2] + sqrt(best_d2);
+        if((take_lo ? chord_lo : chord_hi) <= reach * reach)
+        {
+            searchRange(range_lo, range_hi, x, y, best, best_d2);
+        }
+    }
+}
+
+template <typename Visit>
+inline void WaypointIndex::within(double x, double y, double radius, Visit visit) const
+{
+    withinRange(0, m_x.size(), x, y, radius, visit);
+}
+
+template <typename Visit>
+inline void WaypointIndex::withinRange(int lo, int hi, double x, double y, double radius, Visit &visit) const
+{
+    if(hi - lo <= leafSize)
+    {
+        for(int i = lo; i < hi; i++)
+        {
+            double dx = x - m_x[i];
+            double dy = y - m_y[i];
+            if(dx * dx + dy * dy <= radius * radius)
+            {
+                visit(i);
+            }
+        }
+        return;
+    }
+
+    // A half can only hold a waypoint in range when its capsule reaches it
+    int mid = (lo + hi) / 2;
+    double reach_lo = m_radius[(lo + mid) / 2] + radius;
+    double reach_hi = m_radius[(mid + hi) / 2] + radius;
+    if(chordDistance2(lo, mid, x, y) <= reach_lo * reach_lo)
+    {
+        withinRange(lo, mid, x, y, radius, visit);
+    }
+    if(chordDistance2(mid, hi, x, y) <= reach_hi * reach_hi)
+    {
+        withinRange(mid, hi, x, y, radius, visit);
+    }
+}
+
+/****************************************************************/
+/* Caller-held cursor remembering the segment of the previous getXY query,
+ * so monotone, nearby queries find their segment in amortized O(1) */
+/****************************************************************/
+struct SegmentHint
+{
+    int wp = -1;
+};
+
+/****************************************************************/
+/* Waypoint map of the track, x,y,s and d normalized normal vectors,
+ * together with the lookup structures derived from it at load time.
+ * The columns are views, backed either by the map's own storage
+ * (loadCsv, buildIndex) or by a mapped map file */
+/****************************************************************/
+class HighwayMap
+{
+public:
+    HighwayMap() {}
+    // Views point into the storage, moving keeps the buffers but copying would not
+    HighwayMap(const HighwayMap &) = delete;
+    HighwayMap &operator=(const HighwayMap &) = delete;
+    HighwayMap(HighwayMap &&) = default;
+    HighwayMap &operator=(HighwayMap &&) = default;
+
+    ConstArray<double> x;
+    ConstArray<double> y;
+    ConstArray<double> s;
+    ConstArray<double> dx;
+    ConstArray<double> dy;
+
+    // The max s value before wrapping around the track back to 0
+    double max_s = 0;
+
+    WaypointIndex index;
+
+    // Cumulative arc length at each waypoint, arc_s[0] = 0. Uses the map's own
+    // s column wherever it agrees with the waypoint geometry
+    ConstArray<double> arc_s;
+
+    // Reads the waypoint rows "x y s d_x d_y", false if nothing could be read
+    bool loadCsv(const std::string &path);
+
+    // Must be called once after the waypoints are loaded from csv, derives
+    // arc_s, max_s and the spatial index
+    void buildIndex();
+
+    // The part of buildIndex() the dense track needs: arc_s and max_s only
+    void buildArcLength();
+
+    // Maps any s onto the track, [0, max_s)
+    double wrapS(double s) const;
+
+    // Segment holding a wrapped s: the last waypoint whose arc_s is below s,
+    // waypoint 0 for s = 0. Starts from the hint when one is given
+    int segmentOf(double s, SegmentHint *hint = nullptr) const;
+
+private:
+    std::vector<double> m_x, m_y, m_s, m_dx, m_dy;
+    std::vector<double> m_arc_s;
+};
+
+inline double distance(double x1, double y1, double x2, double y2)
+{
+	return sqrt((x2-x1)*(x2-x1)+(y2-y1)*(y2-y1));
+}
+
+inline bool HighwayMap::loadCsv(const std::string &path)
+{
+    std::ifstream in_map_(path.c_str(), std::ifstream::in);
+
+    m_x.clear(); m_y.clear(); m_s.clear(); m_dx.clear(); m_dy.clear();
+
+    std::string line;
+    while (getline(in_map_, line)) {
+        std::istringstream iss(line);
+        double wp_x, wp_y, wp_s, d_x, d_y;
+        if(!(iss >> wp_x >> wp_y >> wp_s >> d_x >> d_y))
+        {
+            continue;
+        }
+        m_x.push_back(wp_x);
+        m_y.push_back(wp_y);
+        m_s.push_back(wp_s);
+        m_dx.push_back(d_x);
+        m_dy.push_back(d_y);
+    }
+
+    x = m_x; y = m_y; s = m_s; dx = m_dx; dy = m_dy;
+    max_s = 0;
+    return !m_x.empty();
+}
+
+inline void HighwayMap::buildIndex()
+{
+    buildArcLength();
+    index.build(x, y);
+}
+
+inline void HighwayMap::buildArcLength()
+{
+    // Largest disagreement between the s column and the integrated geometry
+    // that is still put down to the precision the map was written with
+    const double arcTolerance = 0.05;
+
+    size_t n = x.size();
+    m_arc_s.resize(n);
+    arc_s = m_arc_s;
+    if(n == 0)
+    {
+        return;
+    }
+
+    m_arc_s[0] = 0;
+    for(size_t i = 1; i < n; i++)
+    {
+        double geometric = m_arc_s[i-1] + distance(x[i-1], y[i-1], x[i], y[i]);
+        bool consistent = (i < s.size()) && (fabs(s[i] - geometric) <= arcTolerance);
+        m_arc_s[i] = consistent ? s[i] : geometric;
+    }
+
+    // The closing segment from the last waypoint back to the first one
+    // ends at max_s, derive max_s from the geometry if it was not given
+    // or does not match it
+    double closing = distance(x[n-1], y[n-1], x[0], y[0]);
+    if(max_s <= m_arc_s[n-1] || fabs(max_s - (m_arc_s[n-1] + closing)) > arcTolerance)
+    {
+        max_s = m_arc_s[n-1] + closing;
+    }
+}
+
+inline double HighwayMap::wrapS(double s) const
+{
+    s = fmod(s, max_s);
+    if(s < 0)
+    {
+        s += max_s;
+    }
+    return s;
+}
+
+inline int HighwayMap::segmentOf(double s, SegmentHint *hint) const
+{
+    // Segments walked from the hint before giving up on it
+    const int hintSteps = 4;
+
+    int n = arc_s.size();
+    if((hint != nullptr) && (hint->wp >= 0) && (hint->wp < n))
+    {
+        int wp = hint->wp;
+        for(int step = 0; step <= hintSteps; step++)
+        {
+            double seg_end = (wp + 1 < n) ? arc_s[wp + 1] : max_s;
+            if(s > seg_end)
+            {
+                wp++;
+            }
+            else if((s <= arc_s[wp]) && (wp > 0))
+            {
+                wp--;
+            }
+            else
+            {
+                hint->wp = wp;
+                return wp;
+            }
+        }
+    }
+
+    int wp = std::lower_bound(arc_s.begin(), arc_s.end(), s) - arc_s.begin() - 1;
+    wp = std::max(wp, 0);
+    if(hint != nullptr)
+    {
+        hint->wp = wp;
+    }
+    return wp;
+}
+
+inline int ClosestWaypoint(double x, double y, const HighwayMap &map)
+{
+	return map.index.nearest(x,y);
+}
+
+inline int NextWaypoint(double x, double y, double theta, const HighwayMap &map)
+{
+	const ConstArray<double> &maps_x = map.x;
+	const ConstArray<double> &maps_y = map.y;
+
+	int closestWaypoint = ClosestWaypoint(x,y,map);
+
+	double map_x = maps_x[closestWaypoint];
+	double map_y = maps_y[closestWaypoint];
+
+	double heading = atan2((map_y-y),(map_x-x));
+
+	double angle = fabs(theta-heading);
+
+	if(angle > pi()/4)
+	{
+		closestWaypoint++;
+	}
+
+	// Past the last waypoint the next one is the start of the track again
+	if(closestWaypoint == (int)maps_x.size())
+	{
+		closestWaypoint = 0;
+	}
+
+  return closestWaypoint;
+}
+
+// Transform from Cartesian x,y coordinates to Frenet s,d coordinates
+inline FrenetPoint getFrenet(double x, double y, double theta, const HighwayMap &map)
+{
+	const ConstArray<double> &maps_x = map.x;
+	const ConstArray<double> &maps_y = map.y;
+
+	int next_wp = NextWaypoint(x,y, theta, map);
+
+	int prev_wp;
+	prev_wp = next_wp-1;
+	if(next_wp == 0)
+	{
+		prev_wp  = maps_x.size()-1;
+	}
+
+	double n_x = maps_x[next_wp]-maps_x[prev_wp];
+	double n_y = maps_y[next_wp]-maps_y[prev_wp];
+	double x_x = x - maps_x[prev_wp];
+	double x_y = y - maps_y[prev_wp];
+
+	// find the projection of x onto n
+	double proj_norm = (x_x*n_x+x_y*n_y)/(n_x*n_x+n_y*n_y);
+	double proj_x = proj_norm*n_x;
+	double proj_y = proj_norm*n_y;
+
+	double frenet_d = distance(x_x,x_y,proj_x,proj_y);
+
+	//see if d value is positive or negative by comparing it to a center point
+
+	double center_x = 1000-maps_x[prev_wp];
+	double center_y = 2000-maps_y[prev_wp];
+	double centerToPos = distance(center_x,center_y,x_x,x_y);
+	double centerToRef = distance(center_x,center_y,proj_x,proj_y);
+
+	if(centerToPos <= centerToRef)
+	{
+		frenet_d *= -1;
+	}
+
+	// calculate s value from the arc length table, wrapping on the closing segment
+	double frenet_s = map.arc_s[prev_wp] + distance(0,0,proj_x,proj_y);
+	if(frenet_s >= map.max_s)
+	{
+		frenet_s -= map.max_s;
+	}
+
+	return {frenet_s,frenet_d};
+
+}
+
+// Transform from Frenet s,d coordinates to Cartesian x,y
+// s is wrapped onto the track, the optional hint speeds up nearby queries
+inline XY getXY(double s, double d, const HighwayMap &map, SegmentHint *hint = nullptr)
+{
+	const ConstArray<double> &maps_s = map.arc_s;
+	const ConstArray<double> &maps_x = map.x;
+	const ConstArray<double> &maps_y = map.y;
+
+	s = map.wrapS(s);
+	int prev_wp = map.segmentOf(s, hint);
+
+	int wp2 = (prev_wp+1)%maps_x.size();
+
+	double heading = atan2((maps_y[wp2]-maps_y[prev_wp]),(maps_x[wp2]-maps_x[prev_wp]));
+	// the x,y,s along the segment
+	double seg_s = (s-maps_s[prev_wp]);
+
+	double seg_x = maps_x[prev_wp]+seg_s*cos(heading);
+	double seg_y = maps_y[prev_wp]+seg_s*sin(heading);
+
+	double perp_heading = heading-pi()/2;
+
+	double x = seg_x + d*cos(perp_heading);
+	double y = seg_y + d*sin(perp_heading);
+
+	return {x,y};
+
+}
+
+#endif /* HIGHWAY_MAP_H */
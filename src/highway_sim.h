@@ -0,0 +1,485 @@
+#ifndef HIGHWAY_SIM_H
+#define HIGHWAY_SIM_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "telemetry.h"
+#include "highway_map.h"
+#include "dense_track.h"
+#include "frenet_projector.h"
+
+/****************************************************************/
+/* Settings of the headless simulator. Speeds in m/s, distances in m */
+/****************************************************************/
+struct SimConfig
+{
+    int vehicles = 12;
+    int lanes = 3;
+    double lane_width = 4.0;
+    double speed_limit = 50.0 / 2.24;
+    // Path points the car drives, 20 ms each, between two telemetry frames
+    int ticks_per_frame = 3;
+    unsigned seed = 1;
+    // Standard deviation of the noise on the s,d reported for the traffic
+    double frenet_noise = 0;
+
+    // Where the simulator puts the car
+    double start_s = 124.8342;
+    double start_d = 6.164833;
+
+    // Limits checked on the car, total acceleration and jerk averaged over 0.2 s
+    double max_accel = 10.0;
+    double max_jerk = 10.0;
+    // Footprint used for collisions, along and across the road
+    double car_length = 4.5;
+    double car_width = 2.0;
+
+    // Traffic driver model: intelligent driver model towards a desired speed
+    // between the two fractions of the limit, lane changes at the given rate
+    double traffic_min_speed = 0.6;
+    double traffic_max_speed = 0.95;
+    double traffic_accel = 1.5;
+    double traffic_brake = 2.0;
+    double traffic_headway = 1.5;       // s
+    double traffic_min_gap = 4.0;
+    double lane_changes_per_minute = 3.0;
+    double lane_change_rate = 1.0;      // m/s across
+};
+
+/****************************************************************/
+/* Closed-loop results. Violations count the times a limit was broken,
+ * not the ticks spent over it */
+/****************************************************************/
+struct SimReport
+{
+    uint64_t ticks = 0;
+    uint64_t frames = 0;
+    double distance = 0;
+    int collisions = 0;
+    int accel_violations = 0;
+    int jerk_violations = 0;
+    int speed_violations = 0;
+    int off_road = 0;
+    uint64_t starved_ticks = 0;         // the car had no path point left
+    double max_speed = 0;
+    double max_accel = 0;
+    double max_jerk = 0;
+
+    double seconds() const { return ticks * 0.02; }
+    double averageSpeedMph() const { return ticks ? distance / seconds() * 2.24 : 0; }
+};
+
+/****************************************************************/
+/* Stand-in for the simulator: drives the car along the path points
+ * of the planner's replies one per 20 ms tick, moves the traffic and
+ * writes the telemetry frames the simulator would send, in the same
+ * socket.io framing. Whether frame and reply go over a websocket or
+ * are handed straight to a PlannerSession is up to the caller */
+/****************************************************************/
+class HighwaySim
+{
+public:
+    HighwaySim(const HighwayMap &map, const DenseTrack &track, const SimConfig &config = SimConfig());
+
+    // Telemetry frame of the current state
+    void telemetry(std::string &frame);
+    // Takes the path of the planner's reply, then drives ticks_per_frame
+    // ticks. False when the reply is not a control message
+    bool control(const char *data, size_t length);
+
+    const SimReport &report() const { return m_report; }
+    // Vehicles placed on the road, fewer than asked for when they did not fit
+    int vehicles() const { return m_traffic.size(); }
+
+private:
+    static const int window = 10;       // ticks in 0.2 s
+    static constexpr double dt = 0.02;
+
+    struct Vehicle
+    {
+        int id;
+        double s, d;
+        double speed;
+        double desired_speed;
+        double target_d;
+    };
+
+    // The last window + 1 samples of an x,y quantity in a fixed ring, so
+    // a tick only overwrites the oldest
+    struct History
+    {
+        static const int size = window + 1;
+        double x[size], y[size];
+        int next = 0;                   // slot of the next sample, the oldest once full
+        int count = 0;
+
+        void push(double sample_x, double sample_y)
+        {
+            x[next] = sample_x;
+            y[next] = sample_y;
+            next = (next + 1) % size;
+            count = (count < size) ? count + 1 : size;
+        }
+        bool full() const { return count == size; }
+        // Newest sample minus the oldest, once full
+        double spanX() const { return x[(next + size - 1) % size] - x[next]; }
+        double spanY() const { return y[(next + size - 1) % size] - y[next]; }
+    };
+
+    void spawn();
+    void tick();
+    void moveTraffic();
+    void checkLimits(double vx, double vy);
+    // s distance from a to b along the loop, in -max_s / 2 .. max_s / 2
+    double gap(double a, double b) const;
+    int laneOf(double d) const { return (int)floor(d / m_config.lane_width); }
+    double laneCenter(int lane) const { return m_config.lane_width * (lane + 0.5); }
+
+    const DenseTrack &m_track;
+    SimConfig m_config;
+    FrenetProjector m_projector;
+    std::mt19937 m_random;
+    // Own stream for the s,d noise, so the traffic drives the same with or without it
+    std::mt19937 m_noise_random;
+    double m_max_s;
+
+    // Car
+    double m_x, m_y, m_yaw, m_speed;
+    double m_s, m_d;
+    std::vector<double> m_path_x, m_path_y;
+    size_t m_path_next = 0;
+    // Velocity and acceleration of the last window + 1 ticks
+    History m_velocity, m_accel_history;
+    bool m_over_speed = false, m_over_accel = false, m_over_jerk = false;
+    bool m_colliding = false, m_off_road = false;
+
+    std::vector<Vehicle> m_traffic;
+    std::vector<double> m_accel;        // per vehicle, reused every tick
+
+    SimReport m_report;
+};
+
+inline HighwaySim::HighwaySim(const HighwayMap &map, const DenseTrack &track, const SimConfig &config)
+    : m_track(track), m_config(config), m_projector(map), m_random(config.seed),
+      m_noise_random(config.seed + 1), m_max_s(track.maxS())
+{
+    m_s = m_config.start_s;
+    m_d = m_config.start_d;
+    XY start = m_track.getXY(m_s, m_d);
+    m_x = start.x;
+    m_y = start.y;
+    m_yaw = m_track.sampleAt(m_s).heading;
+    m_speed = 0;
+    m_projector.project(FrenetProjector::egoId, m_x, m_y);
+    spawn();
+}
+
+inline double HighwaySim::gap(double a, double b) const
+{
+    double g = fmod(b - a, m_max_s);
+    if(g > m_max_s / 2)
+    {
+        g -= m_max_s;
+    }
+    else if(g < -m_max_s / 2)
+    {
+        g += m_max_s;
+    }
+    return g;
+}
+
+inline void HighwaySim::spawn()
+{
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::uniform_int_distribution<int> lane_pick(0, m_config.lanes - 1);
+    const double min_spacing = 20;
+    // 600 m around the car, longer when the lanes would be packed tighter
+    // than every other spacing, at most the whole loop
+    const double spread = std::min(std::max(600.0, 2 * min_spacing * m_config.vehicles / m_config.lanes),
+                                   m_max_s - 2 * min_spacing);
+    // Random placement fills about three quarters of what would fit, the
+    // attempts are capped so that asking for more gives up instead of hanging
+    int attempts = 100 * std::max(m_config.vehicles, 1);
+    while((int)m_traffic.size() < m_config.vehicles && attempts-- > 0)
+    {
+        Vehicle v;
+        v.id = m_traffic.size();
+        v.d = laneCenter(lane_pick(m_random));
+        v.s = fmod(m_config.start_s - 100 + unit(m_random) * spread, m_max_s);
+        v.target_d = v.d;
+        v.desired_speed = m_config.speed_limit * (m_config.traffic_min_speed
+                          + unit(m_random) * (m_config.traffic_max_speed - m_config.traffic_min_speed));
+        v.speed = v.desired_speed;
+
+        // Keep clear of the car and of the others in the lane
+        bool clear = !(laneOf(v.d) == laneOf(m_d) && fabs(gap(m_s, v.s)) < 2 * min_spacing);
+        for(const Vehicle &other : m_traffic)
+        {
+            clear = clear && !(laneOf(other.d) == laneOf(v.d) && fabs(gap(other.s, v.s)) < min_spacing);
+        }
+        if(clear)
+        {
+            m_traffic.push_back(v);
+        }
+    }
+    m_accel.resize(m_traffic.size());
+}
+
+inline void HighwaySim::telemetry(std::string &frame)
+{
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "42[\"telemetry\",{\"x\":%.10g,\"y\":%.10g,\"yaw\":%.10g,\"speed\":%.10g,\"s\":%.10g,\"d\":%.10g,",
+             m_x, m_y, m_yaw * 180 / pi(), m_speed * 2.24, m_s, m_d);
+    frame = buffer;
+
+    const std::vector<double> *path[2] = {&m_path_x, &m_path_y};
+    const char *keys[2] = {"\"previous_path_x\":[", ",\"previous_path_y\":["};
+    for(int axis = 0; axis < 2; axis++)
+    {
+        frame += keys[axis];
+        for(size_t i = m_path_next; i < path[axis]->size(); i++)
+        {
+            snprintf(buffer, sizeof(buffer), (i > m_path_next) ? ",%.10g" : "%.10g", (*path[axis])[i]);
+            frame += buffer;
+        }
+        frame += "]";
+    }
+
+    // The simulator reports the end of the previous path, zeros without one
+    FrenetPoint end = {0, 0};
+    if(m_path_next < m_path_x.size())
+    {
+        end = m_projector.project(m_config.vehicles, m_path_x.back(), m_path_y.back());
+    }
+    snprintf(buffer, sizeof(buffer), ",\"end_path_s\":%.10g,\"end_path_d\":%.10g,\"sensor_fusion\":[", end.s, end.d);
+    frame += buffer;
+
+    for(size_t i = 0; i < m_traffic.size(); i++)
+    {
+        const Vehicle &v = m_traffic[i];
+        const TrackSample &sample = m_track.sampleAt(v.s);
+        XY position = m_track.getXY(v.s, v.d);
+        // s,d as the simulator reports them, projected from x,y onto the map
+        FrenetPoint frenet = m_projector.project(v.id, position.x, position.y);
+        if(m_config.frenet_noise > 0)
+        {
+            std::normal_distribution<double> noise(0, m_config.frenet_noise);
+            frenet.s += noise(m_noise_random);
+            frenet.d += noise(m_noise_random);
+        }
+        double lateral = (v.target_d == v.d) ? 0 : copysign(m_config.lane_change_rate, v.target_d - v.d);
+        double vx = v.speed * cos(sample.heading) + lateral * sample.nx;
+        double vy = v.speed * sin(sample.heading) + lateral * sample.ny;
+        snprintf(buffer, sizeof(buffer), "%s[%d,%.10g,%.10g,%.10g,%.10g,%.10g,%.10g]", i ? "," : "",
+                 v.id, position.x, position.y, vx, vy, frenet.s, frenet.d);
+        frame += buffer;
+    }
+    frame += "]}]";
+}
+
+inline bool HighwaySim::control(const char *data, size_t length)
+{
+    // The planner's replies always take the streaming parser, the json
+    // path is for whatever else a planner over the websocket may send
+    if(!TelemetryParser::parseControl(data, length, m_path_x, m_path_y))
+    {
+        if(length < 13 || memcmp(data, "42[\"control\",", 13) != 0)
+        {
+            return false;
+        }
+        nlohmann::json j = nlohmann::json::parse(data + 2, data + length);
+        if(!j.is_array() || j.size() < 2 || !j[1].is_object())
+        {
+            return false;
+        }
+        const nlohmann::json &next_x = j[1]["next_x"];
+        const nlohmann::json &next_y = j[1]["next_y"];
+        if(!next_x.is_array() || !next_y.is_array() || next_x.size() != next_y.size())
+        {
+            return false;
+        }
+        m_path_x.clear();
+        m_path_y.clear();
+        for(size_t i = 0; i < next_x.size(); i++)
+        {
+            if(!next_x[i].is_number() || !next_y[i].is_number())
+            {
+                return false;
+            }
+            m_path_x.push_back(next_x[i]);
+            m_path_y.push_back(next_y[i]);
+        }
+    }
+    m_path_next = 0;
+
+    m_report.frames++;
+    for(int i = 0; i < m_config.ticks_per_frame; i++)
+    {
+        tick();
+    }
+    return true;
+}
+
+inline void HighwaySim::tick()
+{
+    double x = m_x, y = m_y;
+    if(m_path_next < m_path_x.size())
+    {
+        x = m_path_x[m_path_next];
+        y = m_path_y[m_path_next];
+        m_path_next++;
+    }
+    else
+    {
+        m_report.starved_ticks++;
+    }
+
+    double vx = (x - m_x) / dt;
+    double vy = (y - m_y) / dt;
+    double step = sqrt((x - m_x) * (x - m_x) + (y - m_y) * (y - m_y));
+    if(step > 1e-6)
+    {
+        m_yaw = atan2(y - m_y, x - m_x);
+    }
+    m_x = x;
+    m_y = y;
+    m_speed = step / dt;
+    FrenetPoint frenet = m_projector.project(FrenetProjector::egoId, m_x, m_y);
+    m_s = frenet.s;
+    m_d = frenet.d;
+    m_report.distance += step;
+    m_report.ticks++;
+
+    moveTraffic();
+    checkLimits(vx, vy);
+}
+
+inline void HighwaySim::moveTraffic()
+{
+    const SimConfig &c = m_config;
+    std::uniform_real_distribution<double> unit(0, 1);
+    double change_chance = c.lane_changes_per_minute / 60 * dt;
+
+    for(size_t i = 0; i < m_traffic.size(); i++)
+    {
+        Vehicle &v = m_traffic[i];
+
+        // Nearest vehicle ahead overlapping the lane, the car included
+        double ahead = 1e9, ahead_speed = 0;
+        for(size_t k = 0; k <= m_traffic.size(); k++)
+        {
+            bool ego = (k == m_traffic.size());
+            if(k == i)
+            {
+                continue;
+            }
+            double other_s = ego ? m_s : m_traffic[k].s;
+            double other_d = ego ? m_d : m_traffic[k].d;
+            double g = gap(v.s, other_s);
+            if(g > 0 && g < ahead && fabs(other_d - v.d) < 0.75 * c.lane_width)
+            {
+                ahead = g;
+                ahead_speed = ego ? m_speed : m_traffic[k].speed;
+            }
+        }
+
+        double desired_gap = c.traffic_min_gap + v.speed * c.traffic_headway
+                             + v.speed * (v.speed - ahead_speed) / (2 * sqrt(c.traffic_accel * c.traffic_brake));
+        double free = 1 - pow(v.speed / v.desired_speed, 4);
+        double interaction = (ahead < 1e9) ? pow(std::max(desired_gap, 0.0) / std::max(ahead - c.car_length, 0.1), 2) : 0;
+        m_accel[i] = std::max(c.traffic_accel * (free - interaction), -9.0);
+
+        // Occasional lane change into a lane with room around
+        if(v.target_d == v.d && unit(m_random) < change_chance)
+        {
+            int lane = laneOf(v.d) + ((unit(m_random) < 0.5) ? -1 : 1);
+            if(lane >= 0 && lane < c.lanes)
+            {
+                // Room for the whole change, a faster car behind closes in meanwhile
+                double change_time = c.lane_width / c.lane_change_rate;
+                bool room = true;
+                for(size_t k = 0; k <= m_traffic.size() && room; k++)
+                {
+                    bool ego = (k == m_traffic.size());
+                    if(k == i)
+                    {
+                        continue;
+                    }
+                    double other_d = ego ? m_d : m_traffic[k].d;
+                    double other_speed = ego ? m_speed : m_traffic[k].speed;
+                    double g = gap(v.s, ego ? m_s : m_traffic[k].s);
+                    double behind = 15 + std::max(other_speed - v.speed, 0.0) * change_time;
+                    room = !(laneOf(other_d) == lane && g > -behind && g < 25);
+                }
+                if(room)
+                {
+                    v.target_d = laneCenter(lane);
+                }
+            }
+        }
+    }
+
+    for(size_t i = 0; i < m_traffic.size(); i++)
+    {
+        Vehicle &v = m_traffic[i];
+        v.speed = std::max(v.speed + m_accel[i] * dt, 0.0);
+        v.s = fmod(v.s + v.speed * dt, m_max_s);
+        double lateral = c.lane_change_rate * dt;
+        v.d = (fabs(v.target_d - v.d) <= lateral) ? v.target_d : v.d + copysign(lateral, v.target_d - v.d);
+    }
+}
+
+inline void HighwaySim::checkLimits(double vx, double vy)
+{
+    const SimConfig &c = m_config;
+    m_report.max_speed = std::max(m_report.max_speed, m_speed);
+    bool over_speed = m_speed > c.speed_limit;
+    m_report.speed_violations += (over_speed && !m_over_speed) ? 1 : 0;
+    m_over_speed = over_speed;
+
+    // Total acceleration and jerk over the last 0.2 s, once there is that much
+    m_velocity.push(vx, vy);
+    if(m_velocity.full())
+    {
+        double ax = m_velocity.spanX() / (window * dt);
+        double ay = m_velocity.spanY() / (window * dt);
+        double accel = sqrt(ax * ax + ay * ay);
+        m_report.max_accel = std::max(m_report.max_accel, accel);
+        bool over_accel = accel > c.max_accel;
+        m_report.accel_violations += (over_accel && !m_over_accel) ? 1 : 0;
+        m_over_accel = over_accel;
+
+        m_accel_history.push(ax, ay);
+        if(m_accel_history.full())
+        {
+            double jx = m_accel_history.spanX() / (window * dt);
+            double jy = m_accel_history.spanY() / (window * dt);
+            double jerk = sqrt(jx * jx + jy * jy);
+            m_report.max_jerk = std::max(m_report.max_jerk, jerk);
+            bool over_jerk = jerk > c.max_jerk;
+            m_report.jerk_violations += (over_jerk && !m_over_jerk) ? 1 : 0;
+            m_over_jerk = over_jerk;
+        }
+    }
+
+    bool colliding = false;
+    for(const Vehicle &v : m_traffic)
+    {
+        colliding = colliding || (fabs(gap(m_s, v.s)) < c.car_length && fabs(v.d - m_d) < c.car_width);
+    }
+    m_report.collisions += (colliding && !m_colliding) ? 1 : 0;
+    m_colliding = colliding;
+
+    bool off_road = m_d < 0 || m_d > c.lanes * c.lane_width;
+    m_report.off_road += (off_road && !m_off_road) ? 1 : 0;
+    m_off_road = off_road;
+}
+
+#endif /* HIGHWAY_SIM_H */
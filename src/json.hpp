@@ -74,6 +74,11 @@ SOFTWARE.
     #pragma GCC diagnostic ignored "-Wfloat-equal"
 #endif
 
+// GCC 12 and later see json_value moved uninitialized when optimizing
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
 // disable documentation warnings on clang
 #if defined(__clang__)
     #pragma GCC diagnostic push
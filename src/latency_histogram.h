@@ -0,0 +1,118 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+/****************************************************************/
+/* Latency histogram in the HDR style: every power of two of
+ * nanoseconds is split into sub_buckets equal buckets, so any value
+ * is kept to within 1 / sub_buckets of itself from 1 ns up to over a
+ * day, in a fixed table. Values go in and come out in us, sub-us stages
+ * keep their fraction. Recording is a few integer operations and never
+ * allocates; histograms of the same shape merge by adding */
+/****************************************************************/
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() { reset(); }
+
+    void reset()
+    {
+        memset(m_counts, 0, sizeof(m_counts));
+        m_count = 0;
+        m_sum_us = 0;
+        m_max_us = 0;
+    }
+
+    void record(double us)
+    {
+        uint64_t ns = (us > 0) ? (uint64_t)(us * 1000) : 0;
+        m_counts[bucketOf(ns)]++;
+        m_count++;
+        m_sum_us += us;
+        m_max_us = std::max(m_max_us, us);
+    }
+    void recordMs(double ms) { record(ms * 1000); }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for(int i = 0; i < bucket_count; i++)
+        {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_count += other.m_count;
+        m_sum_us += other.m_sum_us;
+        m_max_us = std::max(m_max_us, other.m_max_us);
+    }
+
+    uint64_t count() const { return m_count; }
+    double sumUs() const { return m_sum_us; }
+    double meanUs() const { return m_count ? m_sum_us / m_count : 0; }
+    double maxUs() const { return m_max_us; }
+
+    // Value at or below which the given fraction of the recorded values lie,
+    // as the upper end of its bucket
+    double percentileUs(double fraction) const
+    {
+        if(m_count == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(fraction * m_count + 0.5);
+        rank = std::min(std::max(rank, (uint64_t)1), m_count);
+        uint64_t seen = 0;
+        for(int i = 0; i < bucket_count; i++)
+        {
+            seen += m_counts[i];
+            if(seen >= rank)
+            {
+                return std::min(bucketEnd(i) * 1e-3, m_max_us);
+            }
+        }
+        return m_max_us;
+    }
+
+private:
+    static const int sub_bucket_bits = 5;
+    static const int sub_buckets = 1 << sub_bucket_bits;
+    static const int magnitudes = 42;
+    static const int bucket_count = (magnitudes + 1) * sub_buckets;
+
+    // Values below sub_buckets map one to one, above that each power of two
+    // takes sub_buckets buckets
+    static int bucketOf(uint64_t value)
+    {
+        if(value < (uint64_t)sub_buckets)
+        {
+            return (int)value;
+        }
+        int magnitude = 63 - __builtin_clzll(value) - sub_bucket_bits + 1;
+        if(magnitude > magnitudes)
+        {
+            return bucket_count - 1;
+        }
+        int sub = (int)(value >> (magnitude - 1)) - sub_buckets;
+        return magnitude * sub_buckets + sub;
+    }
+
+    // Largest value in ns falling into the bucket
+    static uint64_t bucketEnd(int bucket)
+    {
+        int magnitude = bucket / sub_buckets;
+        int sub = bucket % sub_buckets;
+        if(magnitude == 0)
+        {
+            return sub;
+        }
+        return ((uint64_t)(sub_buckets + sub + 1) << (magnitude - 1)) - 1;
+    }
+
+    uint64_t m_counts[bucket_count];
+    uint64_t m_count;
+    double m_sum_us;
+    double m_max_us;
+};
+
+#endif /* LATENCY_HISTOGRAM_H */
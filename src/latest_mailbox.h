@@ -0,0 +1,69 @@
+#ifndef LATEST_MAILBOX_H
+#define LATEST_MAILBOX_H
+
+#include <atomic>
+
+/****************************************************************/
+/* Single-slot mailbox between one producer and one consumer where the
+ * newest value wins: publishing over a value that was never taken
+ * replaces it. Lock-free triple buffer, the producer fills one slot,
+ * the consumer reads another and the third is handed over with a single
+ * atomic exchange. Values are reused, so a value owning memory stops
+ * allocating once it has grown */
+/****************************************************************/
+template<typename T>
+class LatestMailbox
+{
+public:
+    LatestMailbox() : m_write(0), m_middle(1), m_read(2) {}
+    LatestMailbox(const LatestMailbox &) = delete;
+    LatestMailbox &operator=(const LatestMailbox &) = delete;
+
+    // Producer: slot to fill before publish()
+    T &back() { return m_slots[m_write]; }
+    // Producer: makes back() the newest value. True when it replaced a
+    // value the consumer never took
+    bool publish();
+
+    // Consumer: true with front() holding the newest value when one was
+    // published since the last take()
+    bool take();
+    T &front() { return m_slots[m_read]; }
+
+    // Either side: a value is waiting to be taken
+    bool pending() const { return (m_middle.load(std::memory_order_acquire) & fresh) != 0; }
+
+private:
+    enum : unsigned
+    {
+        index_mask = 3,
+        fresh = 4
+    };
+
+    T m_slots[3];
+    unsigned m_write;                   // producer only
+    std::atomic<unsigned> m_middle;     // slot handed over, with fresh set until taken
+    unsigned m_read;                    // consumer only
+};
+
+template<typename T>
+inline bool LatestMailbox<T>::publish()
+{
+    unsigned previous = m_middle.exchange(m_write | fresh, std::memory_order_acq_rel);
+    m_write = previous & index_mask;
+    return (previous & fresh) != 0;
+}
+
+template<typename T>
+inline bool LatestMailbox<T>::take()
+{
+    if(!pending())
+    {
+        return false;
+    }
+    unsigned previous = m_middle.exchange(m_read, std::memory_order_acq_rel);
+    m_read = previous & index_mask;
+    return true;
+}
+
+#endif /* LATEST_MAILBOX_H */
@@ -0,0 +1,57 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "highway_map.h"
+#include "dense_track.h"
+#include "map_file.h"
+
+using namespace std;
+
+/****************************************************************/
+/* Builds the binary map file the planner maps at startup from the
+ * waypoint csv: map_convert [in.csv] [out.bin] [sample pitch in m] */
+/****************************************************************/
+int main(int argc, char *argv[])
+{
+    string csv_file = (argc > 1) ? argv[1] : "../data/highway_map.csv";
+    string bin_file = (argc > 2) ? argv[2] : "../data/highway_map.bin";
+    double pitch = (argc > 3) ? atof(argv[3]) : 0.25;
+
+    if(pitch <= 0)
+    {
+        cerr << "Sample pitch must be positive" << endl;
+        return -1;
+    }
+
+    HighwayMap map;
+    if(!map.loadCsv(csv_file))
+    {
+        cerr << "Failed to read waypoints from " << csv_file << endl;
+        return -1;
+    }
+    map.buildIndex();
+
+    DenseTrack track;
+    track.build(map, pitch);
+
+    if(!MapFile::write(bin_file, map, track))
+    {
+        cerr << "Failed to write " << bin_file << endl;
+        return -1;
+    }
+
+    // Read it back the way the planner will, checksum included
+    MapFile check;
+    HighwayMap mapped;
+    DenseTrack mapped_track;
+    string error;
+    if(!check.open(bin_file, mapped, mapped_track, error, true))
+    {
+        cerr << "Written map does not verify: " << error << endl;
+        return -1;
+    }
+
+    cout << "Wrote " << bin_file << " : " << map.x.size() << " waypoints, "
+         << track.samples().size() << " samples, max_s " << map.max_s << endl;
+    return 0;
+}
@@ -0,0 +1,269 @@
+#ifndef MAP_FILE_H
+#define MAP_FILE_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include "highway_map.h"
+#include "dense_track.h"
+
+/****************************************************************/
+/* Binary map file, built once from the csv by map_convert and mapped
+ * read-only by the planner. Native byte order, every section starts
+ * on an 8 byte boundary:
+ *
+ *   MapFileHeader
+ *   x, y, s, dx, dy, arc_s    waypoint_count doubles each
+ *   index radius              waypoint_count doubles
+ *   track samples             sample_count TrackSample
+ */
+/****************************************************************/
+const char mapFileMagic[8] = {'H', 'W', 'Y', 'M', 'A', 'P', '\0', '\0'};
+const uint32_t mapFileVersion = 2;
+const uint32_t mapFileByteOrder = 0x01020304;
+
+struct MapFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // mapFileByteOrder as seen by the writer
+    uint64_t waypoint_count;
+    uint64_t sample_count;
+    double max_s;
+    uint64_t payload_size;      // bytes following the header
+    uint64_t checksum;          // FNV-1a of the payload, see MapFile::open
+};
+static_assert(sizeof(MapFileHeader) % 8 == 0, "payload must start 8 byte aligned");
+
+/****************************************************************/
+/* Byte offsets of the sections, relative to the end of the header */
+/****************************************************************/
+struct MapFileLayout
+{
+    uint64_t columns;           // x, y, s, dx, dy, arc_s
+    uint64_t index_radius;
+    uint64_t samples;
+    uint64_t size;
+
+    MapFileLayout(uint64_t waypoints, uint64_t sample_count)
+    {
+        uint64_t column = waypoints * sizeof(double);
+        columns = 0;
+        index_radius = columns + 6 * column;
+        samples = index_radius + column;
+        size = samples + sample_count * sizeof(TrackSample);
+    }
+};
+
+inline uint64_t mapFileChecksum(const unsigned char *data, uint64_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(uint64_t i = 0; i < length; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/****************************************************************/
+/* Read-only mapping of a map file. The HighwayMap and DenseTrack
+ * attached by open() read straight from the mapped pages, so they
+ * must not outlive this object */
+/****************************************************************/
+class MapFile
+{
+public:
+    MapFile() : m_base(nullptr), m_length(0) {}
+    ~MapFile() { close(); }
+    MapFile(const MapFile &) = delete;
+    MapFile &operator=(const MapFile &) = delete;
+
+    // false with a reason in error when the file is missing or not a valid
+    // map. Only the header and the section sizes are checked unless verify
+    // is set: the payload checksum reads every page of the file, which is
+    // what mapping it instead of reading it saves. map_convert verifies the
+    // files it writes
+    bool open(const std::string &path, HighwayMap &map, DenseTrack &track, std::string &error,
+              bool verify = false);
+
+    // Maps the binary map or, failing that, reads and indexes the csv.
+    // binary_error says why the binary map was not used, false when the
+    // csv could not be read either
+    bool load(const std::string &bin_path, const std::string &csv_path, HighwayMap &map, DenseTrack &track,
+              std::string &binary_error);
+
+    // load() for users of the dense track alone: the waypoints are read
+    // but not indexed. The track stays valid as long as this object
+    bool loadTrack(const std::string &bin_path, const std::string &csv_path, DenseTrack &track,
+                   std::string &binary_error);
+
+    static bool write(const std::string &path, const HighwayMap &map, const DenseTrack &track);
+
+private:
+    void close();
+
+    void *m_base;
+    size_t m_length;
+};
+
+inline void MapFile::close()
+{
+    if(m_base != nullptr)
+    {
+        munmap(m_base, m_length);
+        m_base = nullptr;
+        m_length = 0;
+    }
+}
+
+inline bool MapFile::open(const std::string &path, HighwayMap &map, DenseTrack &track, std::string &error,
+                          bool verify)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MapFileHeader))
+    {
+        ::close(fd);
+        error = "truncated header";
+        return false;
+    }
+    void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(base == MAP_FAILED)
+    {
+        error = "mmap failed";
+        return false;
+    }
+    m_base = base;
+    m_length = st.st_size;
+
+    const MapFileHeader &header = *static_cast<const MapFileHeader *>(m_base);
+    const unsigned char *payload = static_cast<const unsigned char *>(m_base) + sizeof(MapFileHeader);
+
+    if(memcmp(header.magic, mapFileMagic, sizeof(mapFileMagic)) != 0)
+    {
+        error = "not a map file";
+    }
+    else if(header.version != mapFileVersion || header.byte_order != mapFileByteOrder)
+    {
+        error = "unsupported version or byte order";
+    }
+    else if(header.waypoint_count < 2 || header.sample_count < 2
+            || header.payload_size != MapFileLayout(header.waypoint_count, header.sample_count).size
+            || header.payload_size > m_length - sizeof(MapFileHeader))
+    {
+        error = "inconsistent section sizes";
+    }
+    else if(verify && mapFileChecksum(payload, header.payload_size) != header.checksum)
+    {
+        error = "checksum mismatch";
+    }
+    else
+    {
+        error.clear();
+    }
+    if(!error.empty())
+    {
+        close();
+        return false;
+    }
+
+    size_t n = header.waypoint_count;
+    MapFileLayout layout(header.waypoint_count, header.sample_count);
+    const double *columns = reinterpret_cast<const double *>(payload + layout.columns);
+
+    map.x = ConstArray<double>(columns, n);
+    map.y = ConstArray<double>(columns + n, n);
+    map.s = ConstArray<double>(columns + 2 * n, n);
+    map.dx = ConstArray<double>(columns + 3 * n, n);
+    map.dy = ConstArray<double>(columns + 4 * n, n);
+    map.arc_s = ConstArray<double>(columns + 5 * n, n);
+    map.max_s = header.max_s;
+    map.index.attach(map.x, map.y,
+                     ConstArray<double>(reinterpret_cast<const double *>(payload + layout.index_radius), n));
+
+    track.attach(ConstArray<TrackSample>(reinterpret_cast<const TrackSample *>(payload + layout.samples),
+                                         header.sample_count), header.max_s);
+    return true;
+}
+
+inline bool MapFile::load(const std::string &bin_path, const std::string &csv_path, HighwayMap &map,
+                           DenseTrack &track, std::string &binary_error)
+{
+    if(open(bin_path, map, track, binary_error))
+    {
+        return true;
+    }
+    if(!map.loadCsv(csv_path))
+    {
+        return false;
+    }
+    // Nearest waypoint queries go through the spatial index from here on
+    map.buildIndex();
+    track.build(map);
+    return true;
+}
+
+inline bool MapFile::loadTrack(const std::string &bin_path, const std::string &csv_path, DenseTrack &track,
+                                std::string &binary_error)
+{
+    // The views of a mapped map are not needed, the samples stay mapped
+    HighwayMap map;
+    if(open(bin_path, map, track, binary_error))
+    {
+        return true;
+    }
+    if(!map.loadCsv(csv_path))
+    {
+        return false;
+    }
+    map.buildArcLength();
+    track.build(map);
+    return true;
+}
+
+inline bool MapFile::write(const std::string &path, const HighwayMap &map, const DenseTrack &track)
+{
+    uint64_t n = map.x.size();
+    MapFileLayout layout(n, track.samples().size());
+    std::vector<unsigned char> payload(layout.size, 0);
+
+    ConstArray<double> columns[] = {map.x, map.y, map.s, map.dx, map.dy, map.arc_s};
+    for(int c = 0; c < 6; c++)
+    {
+        memcpy(&payload[layout.columns + c * n * sizeof(double)], columns[c].data(), n * sizeof(double));
+    }
+    memcpy(&payload[layout.index_radius], map.index.radius().data(), n * sizeof(double));
+    memcpy(&payload[layout.samples], track.samples().data(), track.samples().size() * sizeof(TrackSample));
+
+    MapFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, mapFileMagic, sizeof(mapFileMagic));
+    header.version = mapFileVersion;
+    header.byte_order = mapFileByteOrder;
+    header.waypoint_count = n;
+    header.sample_count = track.samples().size();
+    header.max_s = map.max_s;
+    header.payload_size = layout.size;
+    header.checksum = mapFileChecksum(payload.data(), payload.size());
+
+    std::ofstream out(path.c_str(), std::ofstream::binary | std::ofstream::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(payload.data()), payload.size());
+    return out.good();
+}
+
+#endif /* MAP_FILE_H */
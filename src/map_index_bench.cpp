@@ -0,0 +1,116 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "highway_map.h"
+#include "dense_track.h"
+
+using namespace std;
+
+// The scan ClosestWaypoint did before the index, lowest index on ties
+static int linearNearest(const vector<double> &xs, const vector<double> &ys, double x, double y)
+{
+    int best = 0;
+    double best_d2 = numeric_limits<double>::infinity();
+    for(size_t i = 0; i < xs.size(); i++)
+    {
+        double dx = x - xs[i];
+        double dy = y - ys[i];
+        double d2 = dx * dx + dy * dy;
+        if(d2 < best_d2)
+        {
+            best_d2 = d2;
+            best = i;
+        }
+    }
+    return best;
+}
+
+/****************************************************************/
+/* Times nearest-waypoint queries of WaypointIndex against maps of
+ * 181 up to 1M waypoints, the real map and the smoothed track
+ * resampled ever denser, with query points spread over the road
+ * around the centerline. Every index answer of a sample of the queries
+ * is checked against the linear scan:
+ * map_index_bench [map.csv] [queries] */
+/****************************************************************/
+int main(int argc, char *argv[])
+{
+    string map_file_ = (argc > 1) ? argv[1] : "../data/highway_map.csv";
+    int queries = (argc > 2) ? atoi(argv[2]) : 200000;
+    const int checked = 2000;
+
+    HighwayMap map;
+    if(!map.loadCsv(map_file_))
+    {
+        cerr << "Failed to read waypoints from " << map_file_ << endl;
+        return -1;
+    }
+    map.buildIndex();
+    DenseTrack track;
+    track.build(map);
+
+    // Query points anywhere on the road and a lane beyond either side of it
+    mt19937 random(1);
+    uniform_real_distribution<double> along(0, track.maxS());
+    uniform_real_distribution<double> across(-4, 16);
+    vector<double> qx(queries), qy(queries);
+    for(int i = 0; i < queries; i++)
+    {
+        XY q = track.getXY(along(random), across(random));
+        qx[i] = q.x;
+        qy[i] = q.y;
+    }
+
+    const int counts[] = {181, 1000, 10000, 100000, 1000000};
+    printf("%10s %10s %12s %12s %10s\n", "waypoints", "build ms", "query ns", "scan ns", "mismatch");
+    int mismatches = 0;
+    for(int n : counts)
+    {
+        vector<double> xs, ys;
+        if(n == (int)map.x.size())
+        {
+            xs.assign(map.x.begin(), map.x.end());
+            ys.assign(map.y.begin(), map.y.end());
+        }
+        else
+        {
+            for(int i = 0; i < n; i++)
+            {
+                XY p = track.getXY(track.maxS() * i / n, 0);
+                xs.push_back(p.x);
+                ys.push_back(p.y);
+            }
+        }
+
+        typedef chrono::steady_clock Clock;
+        Clock::time_point start = Clock::now();
+        WaypointIndex index;
+        index.build(xs, ys);
+        double build_ms = chrono::duration<double, milli>(Clock::now() - start).count();
+
+        start = Clock::now();
+        long sum = 0;
+        for(int i = 0; i < queries; i++)
+        {
+            sum += index.nearest(qx[i], qy[i]);
+        }
+        double query_ns = chrono::duration<double, nano>(Clock::now() - start).count() / queries;
+
+        int wrong = 0;
+        start = Clock::now();
+        for(int i = 0; i < checked; i++)
+        {
+            wrong += (linearNearest(xs, ys, qx[i], qy[i]) != index.nearest(qx[i], qy[i])) ? 1 : 0;
+        }
+        double scan_ns = chrono::duration<double, nano>(Clock::now() - start).count() / checked;
+        mismatches += wrong;
+
+        printf("%10d %10.1f %12.1f %12.1f %10d%s\n", n, build_ms, query_ns, scan_ns, wrong, (sum < 0) ? " " : "");
+    }
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,252 @@
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "telemetry.h"
+#include "control_message.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+/****************************************************************/
+/* Frames shaped like the simulator's: the car on its way around the
+ * track, a previous path of up to 50 points and 12 other cars */
+/****************************************************************/
+static void makeFrames(int count, vector<string> &frames)
+{
+    srand(1);
+    for(int f = 0; f < count; f++)
+    {
+        double s = 124.83 + f * 0.4;
+        char buffer[256];
+        string frame = "42[\"telemetry\",{\"x\":";
+        snprintf(buffer, sizeof(buffer), "%.4f,\"y\":%.4f,\"yaw\":%.5f,\"speed\":%.4f,\"s\":%.4f,\"d\":%.5f,",
+                 909.48 + f * 0.4, 1128.67 + (rand() % 100) * 0.01, 0.01 * (rand() % 100), 49.5, s, 6.0 + 0.001 * (rand() % 100));
+        frame += buffer;
+
+        int path = 47 + rand() % 4;
+        const char *axis[2] = {"previous_path_x", "previous_path_y"};
+        for(int a = 0; a < 2; a++)
+        {
+            frame += string("\"") + axis[a] + "\":[";
+            for(int i = 0; i < path; i++)
+            {
+                snprintf(buffer, sizeof(buffer), "%s%.10g", i ? "," : "", (a ? 1128.67 : 909.48) + i * 0.43 + f * 0.4);
+                frame += buffer;
+            }
+            frame += "],";
+        }
+        snprintf(buffer, sizeof(buffer), "\"end_path_s\":%.10g,\"end_path_d\":%.10g,\"sensor_fusion\":[", s + 20, 6.0);
+        frame += buffer;
+        for(int k = 0; k < 12; k++)
+        {
+            snprintf(buffer, sizeof(buffer), "%s[%d,%.10g,%.10g,%.10g,%.10g,%.10g,%.10g]", k ? "," : "", k,
+                     1000.0 + k * 40, 1130.0 + (rand() % 1000) * 0.001, 20.0 + (rand() % 100) * 0.01, 0.1 * (rand() % 10),
+                     s + 15 + 37 * k, 2.0 + 4 * (k % 3) + 0.01 * (rand() % 50));
+            frame += buffer;
+        }
+        frame += "]}]";
+        frames.push_back(frame);
+    }
+}
+
+static bool same(const Telemetry &a, const Telemetry &b)
+{
+    if(a.x != b.x || a.y != b.y || a.s != b.s || a.d != b.d || a.yaw != b.yaw || a.speed != b.speed
+       || a.end_path_s != b.end_path_s || a.end_path_d != b.end_path_d
+       || a.previous_path_x != b.previous_path_x || a.previous_path_y != b.previous_path_y
+       || a.sensor_fusion.size() != b.sensor_fusion.size())
+    {
+        return false;
+    }
+    for(size_t i = 0; i < a.sensor_fusion.size(); i++)
+    {
+        const SensorCar &p = a.sensor_fusion[i], &q = b.sensor_fusion[i];
+        if(p.id != q.id || p.x != q.x || p.y != q.y || p.vx != q.vx || p.vy != q.vy || p.s != q.s || p.d != q.d)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The path the planner took before the streaming parser
+static bool parseJson(const string &frame, Telemetry &out)
+{
+    string s = hasData(frame);
+    if(s == "")
+    {
+        return false;
+    }
+    json j = json::parse(s);
+    if(j[0].get<string>() != "telemetry")
+    {
+        return false;
+    }
+    telemetryFromJson(j[1], out);
+    return true;
+}
+
+// The reply the planner built before the control message writer
+static void writeJson(const vector<double> &x, const vector<double> &y, string &out)
+{
+    json msgJson;
+    msgJson["next_x"] = x;
+    msgJson["next_y"] = y;
+    out = "42[\"control\","+ msgJson.dump()+"]";
+}
+
+/****************************************************************/
+/* Compares the hand-written message paths with nlohmann::json: the
+ * streaming parser with json::parse on recorded telemetry frames, one
+ * websocket message per line, or on generated ones, and the control
+ * message writer with json::dump on the paths of those frames:
+ * message_bench [frames.txt] [passes] */
+/****************************************************************/
+int main(int argc, char *argv[])
+{
+    vector<string> frames;
+    if(argc > 1)
+    {
+        ifstream in(argv[1]);
+        string line;
+        while(getline(in, line))
+        {
+            if(!line.empty())
+            {
+                frames.push_back(line);
+            }
+        }
+        if(frames.empty())
+        {
+            cerr << "No frames in " << argv[1] << endl;
+            return -1;
+        }
+    }
+    else
+    {
+        makeFrames(1000, frames);
+    }
+    int passes = (argc > 2) ? atoi(argv[2]) : 20;
+
+    // Both paths must agree on every frame the streaming parser takes
+    Telemetry fast, slow;
+    fast.reserve(50, 64);
+    slow.reserve(50, 64);
+    int taken = 0, differ = 0;
+    for(const string &frame : frames)
+    {
+        if(TelemetryParser::parse(frame.data(), frame.size(), fast))
+        {
+            taken++;
+            if(!parseJson(frame, slow) || !same(fast, slow))
+            {
+                differ++;
+            }
+        }
+    }
+
+    typedef chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    for(int p = 0; p < passes; p++)
+    {
+        for(const string &frame : frames)
+        {
+            parseJson(frame, slow);
+        }
+    }
+    double json_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (passes * frames.size());
+
+    start = Clock::now();
+    for(int p = 0; p < passes; p++)
+    {
+        for(const string &frame : frames)
+        {
+            TelemetryParser::parse(frame.data(), frame.size(), fast);
+        }
+    }
+    double fast_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (passes * frames.size());
+
+    cout << frames.size() << " frames, " << taken << " taken by the streaming parser, "
+         << differ << " differ from json" << endl;
+    cout << "json::parse " << json_ns / 1000 << " us/frame, streaming " << fast_ns / 1000
+         << " us/frame, " << json_ns / fast_ns << "x" << endl;
+
+    // Replies of 50 points made from the previous paths of the frames
+    vector<vector<double> > paths_x, paths_y;
+    for(const string &frame : frames)
+    {
+        if(TelemetryParser::parse(frame.data(), frame.size(), fast))
+        {
+            vector<double> x = fast.previous_path_x, y = fast.previous_path_y;
+            for(size_t i = x.size(); i < 50; i++)
+            {
+                x.push_back(fast.x + 1.3 * i / 3);
+                y.push_back(fast.y - 0.1 * i / 7);
+            }
+            paths_x.push_back(x);
+            paths_y.push_back(y);
+        }
+    }
+    if(paths_x.empty())
+    {
+        return differ ? 1 : 0;
+    }
+
+    // The writer rounds to 9 decimals, what json reads back must be that close
+    string reply_json, reply;
+    reply.reserve(control_message::capacity(50));
+    double worst = 0;
+    for(size_t f = 0; f < paths_x.size(); f++)
+    {
+        control_message::write(paths_x[f].data(), paths_y[f].data(), paths_x[f].size(), reply);
+        json j = json::parse(reply.substr(2));
+        if(j[0] != "control" || j[1]["next_x"].size() != paths_x[f].size() || j[1]["next_y"].size() != paths_y[f].size())
+        {
+            worst = HUGE_VAL;
+            break;
+        }
+        for(size_t i = 0; i < paths_x[f].size(); i++)
+        {
+            worst = max(worst, fabs(j[1]["next_x"][i].get<double>() - paths_x[f][i]));
+            worst = max(worst, fabs(j[1]["next_y"][i].get<double>() - paths_y[f][i]));
+        }
+    }
+
+    start = Clock::now();
+    size_t json_bytes = 0;
+    for(int p = 0; p < passes; p++)
+    {
+        for(size_t f = 0; f < paths_x.size(); f++)
+        {
+            writeJson(paths_x[f], paths_y[f], reply_json);
+            json_bytes += reply_json.size();
+        }
+    }
+    double dump_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (passes * paths_x.size());
+
+    start = Clock::now();
+    size_t bytes = 0;
+    for(int p = 0; p < passes; p++)
+    {
+        for(size_t f = 0; f < paths_x.size(); f++)
+        {
+            control_message::write(paths_x[f].data(), paths_y[f].data(), paths_x[f].size(), reply);
+            bytes += reply.size();
+        }
+    }
+    double write_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (passes * paths_x.size());
+
+    bool exact = worst <= 0.5e-9 * (1 + 1e-6);
+    cout << paths_x.size() << " replies, largest difference read back " << worst
+         << (exact ? "" : " (too large)") << endl;
+    cout << "json::dump " << dump_ns / 1000 << " us/frame " << json_bytes / (passes * paths_x.size())
+         << " bytes, writer " << write_ns / 1000 << " us/frame " << bytes / (passes * paths_x.size())
+         << " bytes, " << dump_ns / write_ns << "x" << endl;
+    return (differ || !exact) ? 1 : 0;
+}
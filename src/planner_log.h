@@ -0,0 +1,353 @@
+#ifndef PLANNER_LOG_H
+#define PLANNER_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/****************************************************************/
+/* Log levels. Records below PLANNER_LOG_LEVEL are compiled out */
+/****************************************************************/
+enum LogLevel
+{
+    logDebug = 0,
+    logInfo = 1,
+    logWarning = 2
+};
+
+#ifndef PLANNER_LOG_LEVEL
+#define PLANNER_LOG_LEVEL 0
+#endif
+
+/****************************************************************/
+/* What a record says. Records carry numbers only, the text is put
+ * together by the logger thread when it writes them out */
+/****************************************************************/
+enum LogEvent : uint8_t
+{
+    logFsmState,            // state
+    logLaneDistances,       // too close left, too close right, left front, right front, left back, right back
+    logLaneChangeCosts,     // left, right
+    logBestCandidate,       // lane, speed, horizon, cost
+    logFollowedCandidate,   // lane, speed, horizon, cost
+    logLaneChangeNotSafe,
+    logLaneStabilization,
+    logPathRefit,           // anchor spacing, excess over the limits
+    logConnected,           // connection
+    logConnectionStats,     // connection, received, dropped, sent, mean latency ms, max latency ms
+    logDisconnected         // connection
+};
+
+const int logArgs = 6;
+
+struct LogRecord
+{
+    std::chrono::steady_clock::time_point time;
+    uint32_t source;            // connection, 0 for the server itself
+    uint8_t level;              // LogLevel
+    uint8_t event;              // LogEvent
+    double args[logArgs];
+};
+
+/****************************************************************/
+/* Ring of records from one producer to the logger thread. Writing is
+ * a copy into a preallocated slot and a release store, never a lock or
+ * an allocation; when the logger falls behind the record is dropped
+ * and counted instead */
+/****************************************************************/
+class LogRing
+{
+public:
+    static const uint32_t capacity = 1024;
+
+    explicit LogRing(uint32_t source) : m_source(source), m_records(capacity) {}
+
+    bool push(const LogRecord &record)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if(head - m_tail.load(std::memory_order_acquire) == capacity)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        m_records[head & (capacity - 1)] = record;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t source() const { return m_source; }
+
+private:
+    friend class Logger;
+
+    const uint32_t m_source;
+    std::vector<LogRecord> m_records;
+    std::atomic<uint64_t> m_head{0};        // written by the producer
+    std::atomic<uint64_t> m_tail{0};        // written by the logger thread
+    std::atomic<uint64_t> m_dropped{0};
+    uint64_t m_dropped_reported = 0;        // logger thread only
+    std::atomic<bool> m_released{false};
+};
+
+/****************************************************************/
+/* Background thread draining the rings of all producers every few ms
+ * and writing their records as text. Producers never wait on it, not
+ * even for a flush, so a slow terminal or pipe only costs dropped
+ * records. Rings are in order on their own, records of different
+ * rings may interleave */
+/****************************************************************/
+class Logger
+{
+public:
+    explicit Logger(FILE *out = stdout);
+    ~Logger();
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    // A ring for a new producer, given back with release() once it is done
+    LogRing *open(uint32_t source);
+    // The ring is freed after its last records are written
+    void release(LogRing *ring);
+
+    // Records dropped so far because a ring was full
+    uint64_t dropped();
+
+private:
+    void run();
+    void drain(bool final);
+    void write(const LogRecord &record);
+
+    FILE *m_out;
+    std::chrono::steady_clock::time_point m_start;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+    std::vector<LogRing *> m_rings;         // guarded by m_mutex
+    std::vector<LogRing *> m_draining;      // logger thread only
+    std::vector<LogRing *> m_finished;      // logger thread only
+    uint64_t m_dropped = 0;                 // guarded by m_mutex
+    std::thread m_thread;
+};
+
+/****************************************************************/
+/* What a producer logs through: the level check is a constant, so
+ * records below PLANNER_LOG_LEVEL cost nothing. Without a ring,
+ * records are discarded */
+/****************************************************************/
+class PlannerLog
+{
+public:
+    PlannerLog() = default;
+    ~PlannerLog() { detach(); }
+    PlannerLog(const PlannerLog &) = delete;
+    PlannerLog &operator=(const PlannerLog &) = delete;
+
+    void attach(Logger &logger, uint32_t source)
+    {
+        detach();
+        m_logger = &logger;
+        m_ring = logger.open(source);
+    }
+    void detach()
+    {
+        if(m_ring != nullptr)
+        {
+            m_logger->release(m_ring);
+            m_ring = nullptr;
+        }
+    }
+    bool attached() const { return m_ring != nullptr; }
+
+    template<LogLevel level>
+    void write(LogEvent event, double a0 = 0, double a1 = 0, double a2 = 0, double a3 = 0, double a4 = 0, double a5 = 0) const
+    {
+        if(level < PLANNER_LOG_LEVEL || m_ring == nullptr)
+        {
+            return;
+        }
+        LogRecord record;
+        record.time = std::chrono::steady_clock::now();
+        record.source = m_ring->source();
+        record.level = level;
+        record.event = event;
+        record.args[0] = a0;
+        record.args[1] = a1;
+        record.args[2] = a2;
+        record.args[3] = a3;
+        record.args[4] = a4;
+        record.args[5] = a5;
+        m_ring->push(record);
+    }
+
+private:
+    Logger *m_logger = nullptr;
+    LogRing *m_ring = nullptr;
+};
+
+inline Logger::Logger(FILE *out) : m_out(out), m_start(std::chrono::steady_clock::now())
+{
+    m_thread = std::thread(&Logger::run, this);
+}
+
+inline Logger::~Logger()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+    // Producers release their rings before the logger goes, the rest of
+    // their records has been written by the last drain
+    for(LogRing *ring : m_rings)
+    {
+        delete ring;
+    }
+}
+
+inline LogRing *Logger::open(uint32_t source)
+{
+    LogRing *ring = new LogRing(source);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rings.push_back(ring);
+    return ring;
+}
+
+inline void Logger::release(LogRing *ring)
+{
+    ring->m_released.store(true, std::memory_order_release);
+}
+
+inline uint64_t Logger::dropped()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
+
+inline void Logger::run()
+{
+    const std::chrono::milliseconds period(2);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(!m_stop)
+    {
+        m_wake.wait_for(lock, period, [this] { return m_stop; });
+        bool final = m_stop;
+        lock.unlock();
+        drain(final);
+        lock.lock();
+    }
+}
+
+inline void Logger::drain(bool final)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_draining = m_rings;
+    }
+
+    bool wrote = false;
+    uint64_t dropped = 0;
+    m_finished.clear();
+    for(LogRing *ring : m_draining)
+    {
+        // Read before the records, so none pushed before the release is missed
+        bool done = ring->m_released.load(std::memory_order_acquire);
+        uint64_t tail = ring->m_tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->m_head.load(std::memory_order_acquire);
+        for(; tail != head; tail++)
+        {
+            write(ring->m_records[tail & (LogRing::capacity - 1)]);
+            wrote = true;
+        }
+        ring->m_tail.store(tail, std::memory_order_release);
+
+        uint64_t ring_dropped = ring->m_dropped.load(std::memory_order_relaxed);
+        if(ring_dropped != ring->m_dropped_reported)
+        {
+            fprintf(m_out, "[%u] Log full, %llu records dropped\n", ring->source(),
+                    (unsigned long long)(ring_dropped - ring->m_dropped_reported));
+            dropped += ring_dropped - ring->m_dropped_reported;
+            ring->m_dropped_reported = ring_dropped;
+            wrote = true;
+        }
+        if(done)
+        {
+            m_finished.push_back(ring);
+        }
+    }
+    if(wrote || final)
+    {
+        fflush(m_out);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_dropped += dropped;
+    for(LogRing *ring : m_finished)
+    {
+        m_rings.erase(std::find(m_rings.begin(), m_rings.end(), ring));
+        delete ring;
+    }
+}
+
+inline void Logger::write(const LogRecord &record)
+{
+    static const char *const fsmStateNames[] = {
+        "Current FsmState :: Keep Lane :: ",
+        "FsmState :: Prepare Lane Change : Front Car too close : Decrease Speed : Try Lane change ",
+        "FsmState :: Change Lane Left : Left initiated ",
+        "FsmState :: Change Lane Right : Right initiated "};
+    const double *a = record.args;
+
+    fprintf(m_out, "%.6f [%u] ", std::chrono::duration<double>(record.time - m_start).count(), record.source);
+    switch(record.event)
+    {
+    case logFsmState:
+        fprintf(m_out, "%s\n", fsmStateNames[(int)a[0] & 3]);
+        break;
+    case logLaneDistances:
+        fprintf(m_out, "Car Presence : Left: %s  : Right: %s\n", a[0] ? "true" : "false", a[1] ? "true" : "false");
+        fprintf(m_out, "Nearest Car On : Left Front: %g  : Right Front: %g\n", a[2], a[3]);
+        fprintf(m_out, "Nearest Car On : Left Back: %g  : Right Back: %g\n", a[4], a[5]);
+        fprintf(m_out, "================================================================================\n");
+        break;
+    case logLaneChangeCosts:
+        fprintf(m_out, "LeftChangeCost : %g ,RightChangeCost : %g\n", a[0], a[1]);
+        break;
+    case logBestCandidate:
+        fprintf(m_out, "Best candidate : lane %g ,speed %g ,horizon %g ,cost %g\n", a[0], a[1], a[2], a[3]);
+        break;
+    case logFollowedCandidate:
+        fprintf(m_out, "Followed candidate : lane %g ,speed %g ,horizon %g ,cost %g\n", a[0], a[1], a[2], a[3]);
+        break;
+    case logLaneChangeNotSafe:
+        fprintf(m_out, "+++++++++++ Lane Change Not Safe +++++++++++++++++\n");
+        break;
+    case logLaneStabilization:
+        fprintf(m_out, "Change Lane Stabilization::  \n");
+        break;
+    case logPathRefit:
+        fprintf(m_out, "Path refit : anchors %g m apart ,%g of the limits\n", a[0], a[1]);
+        break;
+    case logConnected:
+        fprintf(m_out, "Connected!!! connection %.0f\n", a[0]);
+        break;
+    case logConnectionStats:
+        fprintf(m_out, "Connection %.0f : Frames received %.0f ,dropped %.0f ,sent %.0f ,latency mean %g ms ,max %g ms\n",
+                a[0], a[1], a[2], a[3], a[4], a[5]);
+        break;
+    case logDisconnected:
+        fprintf(m_out, "Disconnected connection %.0f\n", a[0]);
+        break;
+    default:
+        fprintf(m_out, "Unknown log event %d\n", record.event);
+        break;
+    }
+}
+
+#endif /* PLANNER_LOG_H */
@@ -0,0 +1,153 @@
+#ifndef PLANNER_METRICS_H
+#define PLANNER_METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include "latency_histogram.h"
+#include "planner_session.h"
+
+/****************************************************************/
+/* Stages a frame goes through in the server, timed into one latency
+ * histogram each. The planning stages come from PlannerStageTimes */
+/****************************************************************/
+enum PlannerStage
+{
+    stageReceive,       // frame copied into the mailbox of its connection
+    stageQueue,         // waiting for a planning thread
+    stageParse,
+    stageFallback,      // only frames the streaming parser failed on
+    stageVehicles,
+    stageDecide,
+    stageFit,
+    stagePoints,
+    stageSerialize,
+    stageSend,          // ws.send of the reply
+    stageFrame,         // frame received to its reply sent
+    stageCount
+};
+
+const char *const plannerStageNames[stageCount] = {"receive", "queue", "parse", "fallback", "vehicles",
+                                                   "decide", "fit", "points", "serialize", "send", "frame"};
+
+/****************************************************************/
+/* Latency histograms of every stage and the counters of the server,
+ * summed over all connections. Each thread of the server records into
+ * its own, merged into one when scraped */
+/****************************************************************/
+struct PlannerMetrics
+{
+    LatencyHistogram stages[stageCount];
+    uint64_t frames_received = 0;
+    uint64_t frames_dropped = 0;
+    uint64_t replies_sent = 0;
+    uint64_t planning_cycles = 0;
+    uint64_t manual_frames = 0;
+    uint64_t lane_changes = 0;
+
+    void recordMs(PlannerStage stage, double ms) { stages[stage].recordMs(ms); }
+
+    void reset()
+    {
+        for(int stage = 0; stage < stageCount; stage++)
+        {
+            stages[stage].reset();
+        }
+        frames_received = 0;
+        frames_dropped = 0;
+        replies_sent = 0;
+        planning_cycles = 0;
+        manual_frames = 0;
+        lane_changes = 0;
+    }
+
+    void merge(const PlannerMetrics &other)
+    {
+        for(int stage = 0; stage < stageCount; stage++)
+        {
+            stages[stage].merge(other.stages[stage]);
+        }
+        frames_received += other.frames_received;
+        frames_dropped += other.frames_dropped;
+        replies_sent += other.replies_sent;
+        planning_cycles += other.planning_cycles;
+        manual_frames += other.manual_frames;
+        lane_changes += other.lane_changes;
+    }
+
+    // Stage times of a planning cycle just run
+    void recordCycle(const PlannerStageTimes &times)
+    {
+        planning_cycles++;
+        recordMs(stageParse, times.parse_ms);
+        if(times.fallback)
+        {
+            recordMs(stageFallback, times.fallback_ms);
+        }
+        recordMs(stageVehicles, times.vehicles_ms);
+        recordMs(stageDecide, times.decide_ms);
+        recordMs(stageFit, times.fit_ms);
+        recordMs(stagePoints, times.points_ms);
+        recordMs(stageSerialize, times.serialize_ms);
+    }
+};
+
+/****************************************************************/
+/* Writes the metrics in the Prometheus text format: the stages as a
+ * summary in seconds with the p50, p90, p99 and p99.9 quantiles, plus
+ * their maximum, and the counters as totals */
+/****************************************************************/
+inline void writePrometheus(const PlannerMetrics &metrics, std::string &out)
+{
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    char line[256];
+    out.clear();
+
+    out += "# HELP planner_stage_seconds Time a frame spends in each stage of the server.\n"
+           "# TYPE planner_stage_seconds summary\n";
+    for(int stage = 0; stage < stageCount; stage++)
+    {
+        const LatencyHistogram &histogram = metrics.stages[stage];
+        for(double quantile : quantiles)
+        {
+            snprintf(line, sizeof(line), "planner_stage_seconds{stage=\"%s\",quantile=\"%g\"} %.9g\n",
+                     plannerStageNames[stage], quantile, histogram.percentileUs(quantile) * 1e-6);
+            out += line;
+        }
+        snprintf(line, sizeof(line), "planner_stage_seconds_sum{stage=\"%s\"} %.9g\n"
+                 "planner_stage_seconds_count{stage=\"%s\"} %llu\n", plannerStageNames[stage],
+                 histogram.sumUs() * 1e-6, plannerStageNames[stage], (unsigned long long)histogram.count());
+        out += line;
+    }
+
+    out += "# HELP planner_stage_max_seconds Longest time a frame spent in each stage of the server.\n"
+           "# TYPE planner_stage_max_seconds gauge\n";
+    for(int stage = 0; stage < stageCount; stage++)
+    {
+        snprintf(line, sizeof(line), "planner_stage_max_seconds{stage=\"%s\"} %.9g\n", plannerStageNames[stage],
+                 metrics.stages[stage].maxUs() * 1e-6);
+        out += line;
+    }
+
+    const struct
+    {
+        const char *name;
+        const char *help;
+        uint64_t value;
+    } counters[] = {
+        {"planner_frames_received_total", "Frames received from the simulators.", metrics.frames_received},
+        {"planner_frames_dropped_total", "Frames replaced by a newer one before their reply went out.", metrics.frames_dropped},
+        {"planner_replies_sent_total", "Replies sent to the simulators.", metrics.replies_sent},
+        {"planner_planning_cycles_total", "Telemetry frames planned.", metrics.planning_cycles},
+        {"planner_manual_frames_total", "Frames answered for manual driving.", metrics.manual_frames},
+        {"planner_lane_changes_total", "Lane changes started.", metrics.lane_changes},
+    };
+    for(const auto &counter : counters)
+    {
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counter.name, counter.help,
+                 counter.name, counter.name, (unsigned long long)counter.value);
+        out += line;
+    }
+}
+
+#endif /* PLANNER_METRICS_H */
@@ -0,0 +1,849 @@
+#ifndef PLANNER_SESSION_H
+#define PLANNER_SESSION_H
+
+#include <math.h>
+#include <stdint.h>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "spline.h"
+#include "highway_map.h"
+#include "dense_track.h"
+#include "frenet_projector.h"
+#include "frenet_batch.h"
+#include "alloc_counter.h"
+#include "arc_length_sampler.h"
+#include "candidate_planner.h"
+#include "vehicle_table.h"
+#include "telemetry.h"
+#include "control_message.h"
+#include "planner_log.h"
+
+/****************************************************************/
+/* Defining Enum for direction */
+/****************************************************************/
+enum direction
+{
+    left,
+    right,
+    inlane
+};
+
+/****************************************************************/
+/* Defining Enum for FSM states */
+/****************************************************************/
+enum fsmStates
+{
+    keepLane,
+    prepareLaneChange,
+    laneChangeLeft,
+    laneChangeRight
+};
+
+/****************************************************************/
+/* Constants to take care of max cost decision */
+/****************************************************************/
+const int maxCostFront = 50;
+const int maxCostBack = 30;
+
+const int pathPoints = 50;
+const int anchorPoints = 5;
+
+/****************************************************************/
+/* Speed profile of the new path points: acceleration and jerk well
+ * inside the 10 m/s2 and 10 m/s3 limits, and the rate at which the
+ * speed closes in on the reference speed */
+/****************************************************************/
+const double maxPathAccel = 3.0;        // m/s2
+const double maxPathJerk = 5.0;         // m/s3
+const double speedGain = 1.5;           // 1/s, at most maxPathJerk / maxPathAccel
+// Braking planned for the car ahead, leaving room for the jerk limit, and
+// the gap kept to it
+const double followBrake = 2.0;         // m/s2
+const double followGap = 10.0;          // m
+
+/****************************************************************/
+/* Limits the new path points are checked against before they are
+ * sent, below the simulator's 10 m/s2 and 10 m/s3, and the spacings
+ * of the anchors ahead tried in turn until the path keeps them */
+/****************************************************************/
+const double checkAccel = 9.0;          // m/s2
+const double checkJerk = 9.0;           // m/s3
+const double anchorSpacings[] = {30, 45, 60, 90};   // m
+// Excess over the limits a spacing narrower than the last one must stay
+// below, narrowing steps the curvature up where the paths join
+const double narrowExcess = 0.5;
+// Window the simulator averages acceleration and jerk over
+const double checkWindow = 0.2;         // s
+
+/****************************************************************/
+/* Time spent in each stage of a planning cycle, in ms */
+/****************************************************************/
+struct PlannerStageTimes
+{
+    double parse_ms = 0;                // frame to Telemetry by the streaming parser, or to it failing
+    double fallback_ms = 0;             // hasData and the json DOM after the streaming parser failed
+    bool fallback = false;              // the frame took the json DOM
+    double plan_ms = 0;                 // Telemetry to next_x/next_y, the four below
+    double vehicles_ms = 0;             // sensor fusion to the cars around by lane
+    double decide_ms = 0;               // candidates scored and the FSM stepped
+    double fit_ms = 0;                  // speed profile, the splines through the anchors and their check
+    double points_ms = 0;               // new path points appended
+    double serialize_ms = 0;            // next_x/next_y to the reply
+};
+
+/****************************************************************/
+/* Planner state of one simulator connection: the FSM, the lane
+ * change bookkeeping, the distances to the cars around and the
+ * buffers reused by every planning cycle. The buffers are sized up
+ * front, so a planning cycle does not touch the heap. A session is
+ * driven by one thread at a time, different sessions may run
+ * concurrently */
+/****************************************************************/
+class PlannerSession
+{
+public:
+    PlannerSession(const DenseTrack &track, WorkerPool &workers, const CandidateConfig &config);
+
+    // Logs the FSM and lane change decisions from now on, as the given
+    // connection. Without a logger the session logs nothing
+    void attachLog(Logger &logger, uint32_t connection);
+
+    // Re-derives s,d of the sensor_fusion cars from their x,y on the map
+    // from now on, instead of taking the reported ones, for when those are
+    // stale or noisy. The map must outlive the session
+    void rederiveFrenet(const HighwayMap &map);
+
+    // Handles one websocket message, false when there is nothing to reply
+    bool onMessage(const char *data, size_t length, std::string &reply);
+
+    // Planning cycles run so far and the stage times of the last one
+    uint64_t cycles() const { return m_cycles; }
+    const PlannerStageTimes &stageTimes() const { return m_stage_times; }
+    // Frames answered for manual driving and lane changes started so far
+    uint64_t manualFrames() const { return m_manual_frames; }
+    uint64_t laneChanges() const { return m_lane_changes; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void planCycle(const Telemetry &telemetry, std::string &reply);
+    // Fits the path from the reference points in m_pts_x/y through three
+    // anchors spaced along the lane, samples the fill_size new points and
+    // returns by how much they exceed the checked limits, at most 1 when
+    // they keep them
+    double fitPath(double car_s, int lane, double spacing, int fill_size, bool junction);
+
+    void printLaneDistances(bool tooCloseOnLeft, bool tooCloseOnRight) const;
+    void printFsmState(fsmStates fsm) const;
+    void changeFsmState(fsmStates fsm);
+    double costOfLaneChange(int lane, direction dir) const;
+    void tryLaneShift(int &lane, const CandidateChoice *best, bool tooCloseOnLeft, bool tooCloseOnRight);
+    void updateDistances(direction dir, double frontCarDist, double backCarDist);
+    bool findTooClose(const VehicleTable &vehicles, int lane, double car_s, direction dir);
+
+    const DenseTrack &m_track;
+    PlannerLog m_log;
+    // Last frame, refilled in place every cycle
+    Telemetry m_telemetry;
+    uint64_t m_cycles = 0;
+    PlannerStageTimes m_stage_times;
+    uint64_t m_manual_frames = 0;
+    uint64_t m_lane_changes = 0;
+
+    /* Model FSM state */
+    fsmStates m_fsm_state = fsmStates::keepLane;
+
+    /* Following flags take care of different lane change logics */
+    bool m_lane_change_initiated = false;
+    int m_lane_change_wait = 15;
+
+    /* Following varibales take care of tracking different cars on road */
+    double m_closest_left_front = maxCostFront;
+    double m_closest_left_back = maxCostBack;
+    double m_closest_right_front = maxCostFront;
+    double m_closest_right_back = maxCostBack;
+    double m_closest_inlane_front = maxCostFront;
+    double m_closest_inlane_back = maxCostBack;
+
+    // Current or intended lane number and reference velocity in mph
+    int m_lane_num = 1;
+    double m_ref_v = 0;
+    // Speed, acceleration and curvature at the end of the path sent last,
+    // m/s, m/s2 and 1/m
+    double m_end_v = 0;
+    double m_end_a = 0;
+    double m_end_kappa = 0;
+    // Anchor spacing the path sent last was fitted with, m
+    double m_spacing = 0;
+
+    std::vector<double> m_pts_x;
+    std::vector<double> m_pts_y;
+    std::vector<double> m_next_x_vals;
+    std::vector<double> m_next_y_vals;
+    // With rederiveFrenet(), the cars' segments tracked by id and their
+    // positions converted in one batch
+    std::unique_ptr<FrenetProjector> m_projector;
+    std::unique_ptr<FrenetBatch> m_frenet;
+    std::vector<int> m_fusion_id;
+    std::vector<double> m_fusion_x, m_fusion_y, m_fusion_s, m_fusion_d;
+    // Other cars of the cycle, by lane and s
+    VehicleTable m_vehicles;
+    // Lane x speed x horizon candidates scored every cycle
+    CandidatePlanner m_candidates;
+    tk::spline2d<anchorPoints> m_fit_path;
+    ArcLengthSampler<tk::spline2d<anchorPoints> > m_arc_s;
+    // Distance to travel in each tick of the new points, and the speed and
+    // acceleration there
+    std::array<double, pathPoints> m_fill_step;
+    std::array<double, pathPoints> m_fill_v;
+    std::array<double, pathPoints> m_fill_a;
+    // New points along the spline, curve parameter, global coordinates,
+    // tangent and curvature
+    std::array<double, pathPoints> m_fill_t;
+    std::array<double, pathPoints> m_fill_x;
+    std::array<double, pathPoints> m_fill_y;
+    std::array<double, pathPoints> m_fill_dx;
+    std::array<double, pathPoints> m_fill_dy;
+    std::array<double, pathPoints> m_fill_kappa;
+};
+
+inline PlannerSession::PlannerSession(const DenseTrack &track, WorkerPool &workers, const CandidateConfig &config)
+    : m_track(track),
+      m_vehicles(config.lanes, config.lane_width, config.track_length),
+      m_candidates(workers, config)
+{
+    const int typicalVehicles = 64;
+    m_telemetry.reserve(pathPoints, typicalVehicles);
+    m_vehicles.reserve(typicalVehicles);
+    m_pts_x.reserve(anchorPoints);
+    m_pts_y.reserve(anchorPoints);
+    m_next_x_vals.reserve(pathPoints);
+    m_next_y_vals.reserve(pathPoints);
+}
+
+inline void PlannerSession::rederiveFrenet(const HighwayMap &map)
+{
+    const int typicalVehicles = 64;
+    m_projector.reset(new FrenetProjector(map));
+    m_projector->reserve(typicalVehicles);
+    m_frenet.reset(new FrenetBatch(map));
+    m_frenet->reserve(typicalVehicles);
+    m_fusion_id.reserve(typicalVehicles);
+    m_fusion_x.reserve(typicalVehicles);
+    m_fusion_y.reserve(typicalVehicles);
+    m_fusion_s.resize(typicalVehicles);
+    m_fusion_d.resize(typicalVehicles);
+}
+
+inline void PlannerSession::attachLog(Logger &logger, uint32_t connection)
+{
+    m_log.attach(logger, connection);
+
+    // Print current fsm state
+    printFsmState(m_fsm_state);
+}
+
+/****************************************************************/
+/* Following method prints the other closest cars state and distances */
+/****************************************************************/
+inline void PlannerSession::printLaneDistances(bool tooCloseOnLeft, bool tooCloseOnRight) const
+{
+    m_log.write<logDebug>(logLaneDistances, tooCloseOnLeft, tooCloseOnRight, m_closest_left_front,
+                          m_closest_right_front, m_closest_left_back, m_closest_right_back);
+}
+
+/****************************************************************/
+/* Following method takes care of printing FSM state */
+/****************************************************************/
+inline void PlannerSession::printFsmState(fsmStates fsm) const
+{
+    m_log.write<logInfo>(logFsmState, fsm);
+}
+
+/****************************************************************/
+/* Following method takes care of updating the system fsm state */
+/****************************************************************/
+inline void PlannerSession::changeFsmState(fsmStates fsm)
+{
+    if(m_fsm_state != fsm)
+    {
+        m_fsm_state = fsm;
+        printFsmState(fsm);
+    }
+}
+
+/****************************************************************/
+/* Following method calculates the cost of changing lane to forward, the back side cars
+ * are taken care by tooClose** variables */
+/****************************************************************/
+inline double PlannerSession::costOfLaneChange(int lane, direction dir) const
+{
+    double cost = 100;
+
+    if(direction::left == dir && lane > 0)
+    {
+        cost = (maxCostFront - m_closest_left_front);
+    }
+    else if(direction::right == dir && lane < m_vehicles.lanes() - 1)
+    {
+        cost = (maxCostFront - m_closest_right_front);
+    }
+
+    return cost;
+}
+
+/****************************************************************/
+/* Following method takes the final decision on lane change based on different factors,
+ * mainly the cost of change, and if there is any car too close from back which could
+ * result in collision if lane change is performed. The side is the one of the cheapest
+ * feasible candidate trajectory if there is one, else the cheaper one by cost of change */
+/****************************************************************/
+inline void PlannerSession::tryLaneShift(int &lane, const CandidateChoice *best, bool tooCloseOnLeft, bool tooCloseOnRight)
+{
+    double leftChangeCost = costOfLaneChange(lane, direction::left);
+    double rightChangeCost = costOfLaneChange(lane, direction::right);
+
+    m_log.write<logDebug>(logLaneChangeCosts, leftChangeCost, rightChangeCost);
+    if(best != nullptr)
+    {
+        m_log.write<logDebug>(logBestCandidate, best->lane, best->speed, best->horizon, best->cost);
+    }
+
+    // Prefer taking right, if both lane has 0 cost, since, on highway left most lane is kept for fast running cars
+    bool keepRight = (rightChangeCost == 0) && (leftChangeCost == 0);
+    bool wantLeft = !keepRight && ((best != nullptr) ? (best->lane < lane) : (leftChangeCost < rightChangeCost));
+    bool wantRight = keepRight || ((best != nullptr) ? (best->lane > lane) : (rightChangeCost < leftChangeCost));
+
+    if (wantLeft && (leftChangeCost < 15) && (!tooCloseOnLeft))
+    {
+        lane--;
+        m_lane_change_initiated = true;
+        m_lane_changes++;
+
+        changeFsmState(fsmStates::laneChangeLeft);
+        printLaneDistances(tooCloseOnLeft, tooCloseOnRight);
+    }
+    else if (wantRight && (rightChangeCost < 15) && (!tooCloseOnRight))
+    {
+        lane++;
+        m_lane_change_initiated = true;
+        m_lane_changes++;
+
+        changeFsmState(fsmStates::laneChangeRight);
+        printLaneDistances(tooCloseOnLeft, tooCloseOnRight);
+    }
+    else
+    {
+        m_log.write<logDebug>(logLaneChangeNotSafe);
+        printLaneDistances(tooCloseOnLeft, tooCloseOnRight);
+    }
+}
+
+/****************************************************************/
+/* Following method updates the different distance variables, based on if the detected car
+ * is in lane, left or right */
+/****************************************************************/
+inline void PlannerSession::updateDistances(direction dir, double frontCarDist, double backCarDist)
+{
+    if(dir == direction::inlane)
+    {
+        m_closest_inlane_front = std::min(m_closest_inlane_front, frontCarDist);
+        m_closest_inlane_back = std::min(m_closest_inlane_back, backCarDist);
+    }
+    else if(dir == direction::left)
+    {
+        m_closest_left_front = std::min(m_closest_left_front, frontCarDist);
+        m_closest_left_back = std::min(m_closest_left_back, backCarDist);
+    }
+    else if(dir == direction::right)
+    {
+        m_closest_right_front = std::min(m_closest_right_front, frontCarDist);
+        m_closest_right_back = std::min(m_closest_right_back, backCarDist);
+    }
+}
+
+/****************************************************************/
+/* Following method fits the path and checks it: the total acceleration
+ * combines the speed profile's with v^2 kappa across, and the jerk its
+ * change, where the spline's per segment bounds on |P''| and |P'''| bound
+ * how fast the curvature turns. A curvature step at the end of the
+ * previous path counts as spread over the simulator's window */
+/****************************************************************/
+inline double PlannerSession::fitPath(double car_s, int lane, double spacing, int fill_size, bool junction)
+{
+    std::vector<double> &pts_x = m_pts_x;
+    std::vector<double> &pts_y = m_pts_y;
+    pts_x.resize(2);
+    pts_y.resize(2);
+    for(int k = 1; k <= anchorPoints - 2; k++)
+    {
+        XY anchor = m_track.getXY(car_s + k * spacing, (2 + 4 * lane));
+        pts_x.push_back(anchor.x);
+        pts_y.push_back(anchor.y);
+    }
+
+    // x(t) and y(t) over the chord length in global coordinates, so there is
+    // no rotation into the car frame and the anchors need not increase in x
+    tk::spline2d<anchorPoints> &fit_path = m_fit_path;
+    fit_path.set_points(pts_x.data(), pts_y.data());
+
+    // Break up the spline by arc length so that we travel at the planned speed
+    // from the reference point, the second anchor, on
+    m_arc_s.build(fit_path, fit_path.t_at(1), fit_path.t_at(anchorPoints - 1));
+    m_arc_s.sample(m_fill_step.data(), fill_size, m_fill_t.data());
+
+    // The parameters only ever increase, so both axes are evaluated in one sorted pass
+    fit_path.eval_sorted(m_fill_t.data(), m_fill_x.data(), m_fill_y.data(), fill_size,
+                         m_fill_dx.data(), m_fill_dy.data());
+    fit_path.curvature_sorted(m_fill_t.data(), m_fill_kappa.data(), fill_size);
+
+    double excess = 0;
+    double prev_a = junction ? m_end_a : 0;
+    for(int i = 0; i < fill_size; i++)
+    {
+        double v = m_fill_v[i];
+        double a = m_fill_a[i];
+        double kappa = m_fill_kappa[i];
+        double speed = sqrt(m_fill_dx[i] * m_fill_dx[i] + m_fill_dy[i] * m_fill_dy[i]);
+        size_t seg = fit_path.segment(m_fill_t[i]);
+        // |dkappa/ds| <= |P'''| / |P'|^3 + 3 |kappa| |P''| / |P'|^2
+        double dkappa_ds = fit_path.max_abs_deriv3(seg) / (speed * speed * speed) +
+                           3 * fabs(kappa) * fit_path.max_abs_deriv2(seg) / (speed * speed);
+
+        double accel_n = v * v * kappa;
+        double jerk_t = (a - prev_a) / 0.02;
+        double jerk_n = 2 * v * fabs(a * kappa) + v * v * v * dkappa_ds;
+        if(i == 0 && junction)
+        {
+            jerk_n += v * v * fabs(kappa - m_end_kappa) / checkWindow;
+        }
+        prev_a = a;
+
+        excess = std::max(excess, sqrt(a * a + accel_n * accel_n) / checkAccel);
+        excess = std::max(excess, sqrt(jerk_t * jerk_t + jerk_n * jerk_n) / checkJerk);
+    }
+    return excess;
+}
+
+/****************************************************************/
+/* Following method finds if the nearest car in the given lane is too close, in front,
+ * and for the left and right lane also on the back side for a lane change */
+/****************************************************************/
+inline bool PlannerSession::findTooClose(const VehicleTable &vehicles, int lane, double car_s, direction dir)
+{
+    double frontCarDist = maxCostFront;
+    double backCarDist = maxCostBack;
+
+    bool frontresult = false;
+    bool backresult = false;
+    double gap;
+
+    //check if car is in front and what's the gap between ego vechicle and the subsequent car
+    if(vehicles.leader(lane, car_s, gap) >= 0)
+    {
+        frontCarDist = std::min(frontCarDist, gap);
+        frontresult = (gap < 30);
+    }
+
+    //For right and left lane , check cars on back for lane change
+    if((dir != direction::inlane) && (vehicles.follower(lane, car_s, gap) >= 0))
+    {
+        backCarDist = std::min(backCarDist, gap);
+        backresult = (gap < 10);
+    }
+
+    updateDistances(dir, frontCarDist, backCarDist);
+
+    //In-lane only the front car counts, backresult stays false
+    return frontresult || backresult;
+}
+
+inline bool PlannerSession::onMessage(const char *data, size_t length, std::string &reply)
+{
+    // "42" at the start of the message means there's a websocket message event.
+    // The 4 signifies a websocket message
+    // The 2 signifies a websocket event
+    if (length && length > 2 && data[0] == '4' && data[1] == '2')
+    {
+        Clock::time_point start = Clock::now();
+
+        // Telemetry as the simulator sends it skips the json DOM
+        bool parsed = TelemetryParser::parse(data, length, m_telemetry);
+        Clock::time_point parse_end = Clock::now();
+        m_stage_times.parse_ms = std::chrono::duration<double, std::milli>(parse_end - start).count();
+        m_stage_times.fallback_ms = 0;
+        m_stage_times.fallback = !parsed;
+        if (parsed)
+        {
+            planCycle(m_telemetry, reply);
+            return true;
+        }
+
+        auto s = hasData(std::string(data, length));
+
+        if (s != "")
+        {
+            auto j = nlohmann::json::parse(s);
+
+            std::string event = j[0].get<std::string>();
+
+            if (event == "telemetry")
+            {
+                // j[1] is the data JSON object
+                telemetryFromJson(j[1], m_telemetry);
+                m_stage_times.fallback_ms = std::chrono::duration<double, std::milli>(Clock::now() - parse_end).count();
+                planCycle(m_telemetry, reply);
+                return true;
+            }
+        }
+        else
+        {
+            // Manual driving
+            m_manual_frames++;
+            reply = "42[\"manual\",{}]";
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void PlannerSession::planCycle(const Telemetry &telemetry, std::string &reply)
+{
+    // The reply buffers are reused, only the first replies grow them
+    reply.reserve(control_message::capacity(pathPoints));
+
+    // Everything from the parsed telemetry to the serialized reply runs
+    // without heap allocations, enforced by the allocation counting build
+    AllocationScope planningAllocations;
+    Clock::time_point start = Clock::now();
+
+    // Main car's localization Data
+    double car_x = telemetry.x;
+    double car_y = telemetry.y;
+    double car_s = telemetry.s;
+    double car_d = telemetry.d;
+    double car_yaw = telemetry.yaw;
+
+    // Previous path data given to the Planner
+    const std::vector<double> &previous_path_x = telemetry.previous_path_x;
+    const std::vector<double> &previous_path_y = telemetry.previous_path_y;
+    // Previous path's end s and d values
+    double end_path_s = telemetry.end_path_s;
+    double end_path_d = telemetry.end_path_d;
+
+    // Sensor Fusion Data, a list of all other cars on the same side of the road.
+    const std::vector<SensorCar> &sensor_fusion = telemetry.sensor_fusion;
+
+    // Retrieve previous remaing points and size
+    int prev_size = previous_path_x.size();
+
+    if(prev_size > 0)
+    {
+        car_s = end_path_s;
+    }
+
+    int &lane_num = m_lane_num;
+    double &ref_v = m_ref_v;
+
+    // Following varibales, represents the state if there is any car nearby
+    bool tooCloseInLane = false;
+    bool tooCloseOnLeft = false;
+    bool tooCloseOnRight = false;
+
+    // Reset all variables, since other cars might have moved, and recalculate the distances
+    m_closest_left_front = maxCostFront;
+    m_closest_left_back = maxCostBack;
+    m_closest_right_front = maxCostFront;
+    m_closest_right_back = maxCostBack;
+    m_closest_inlane_front = maxCostFront;
+    m_closest_inlane_back = maxCostBack;
+
+    // Decode the cars once, predicted to the end of the previous path,
+    // with their s,d re-derived from x,y in one batch if asked to
+    if(m_frenet)
+    {
+        m_fusion_id.clear();
+        m_fusion_x.clear();
+        m_fusion_y.clear();
+        for (const SensorCar &car : sensor_fusion)
+        {
+            m_fusion_id.push_back(car.id);
+            m_fusion_x.push_back(car.x);
+            m_fusion_y.push_back(car.y);
+        }
+        if(m_fusion_s.size() < sensor_fusion.size())
+        {
+            m_fusion_s.resize(sensor_fusion.size());
+            m_fusion_d.resize(sensor_fusion.size());
+        }
+        m_frenet->toFrenet(*m_projector, m_fusion_id.data(), m_fusion_x.data(), m_fusion_y.data(),
+                           sensor_fusion.size(), m_fusion_s.data(), m_fusion_d.data());
+    }
+    VehicleTable &vehicles = m_vehicles;
+    vehicles.clear();
+    for (size_t i = 0; i < sensor_fusion.size(); i++)
+    {
+        const SensorCar &car = sensor_fusion[i];
+        vehicles.add(car.id, m_frenet ? m_fusion_s[i] : car.s, m_frenet ? m_fusion_d[i] : car.d, car.vx, car.vy);
+    }
+    vehicles.build(prev_size * 0.02);
+
+    //find if car is in my lane, in left lane and in right lane
+    tooCloseInLane = findTooClose(vehicles, lane_num, car_s, direction::inlane);
+    if (lane_num != 0)
+    {
+        tooCloseOnLeft = findTooClose(vehicles, lane_num - 1, car_s, direction::left);
+    }
+    if (lane_num != vehicles.lanes() - 1)
+    {
+        tooCloseOnRight = findTooClose(vehicles, lane_num + 1, car_s, direction::right);
+    }
+
+    Clock::time_point decoded = Clock::now();
+
+    // The new points go on from the end of the previous path; 2.24 - makes
+    // miles per hour to meters per sec
+    double v = (prev_size > 0) ? m_end_v : telemetry.speed / 2.24;
+    double a = (prev_size > 0) ? m_end_a : 0;
+
+    // Candidates start where the previous path ends, the cars are already predicted to then
+    m_candidates.clearVehicles();
+    for (int i = 0; i < vehicles.size(); i++)
+    {
+        m_candidates.addVehicle(vehicles.s(i), vehicles.d(i), vehicles.speed(i));
+    }
+    QuinticState egoS = {car_s, v, a};
+    QuinticState egoD = {(prev_size > 0) ? end_path_d : car_d, 0, 0};
+    CandidateChoice best;
+    bool foundBest = m_candidates.plan(egoS, egoD, 0, best);
+
+    // If the lane change is initiated, then wait for next decision, until car reaches the intended lane
+    if((m_lane_change_initiated) && (car_d < (2 + 4 * lane_num + 2)) && (car_d > (2 + 4 * lane_num - 2)))
+    {
+        // Change wait gives some stabilization room for car to avoid sudden changes to multiple lanes
+        if(m_lane_change_wait <= 0)
+        {
+            m_lane_change_initiated = false;
+            m_lane_change_wait = 0;
+        }
+        else
+        {
+            m_lane_change_wait--;
+            m_log.write<logDebug>(logLaneStabilization);
+        }
+    }
+    // If the front car is too close, then decrease speed and try changing lane,
+    // if already not initiated
+    if (tooCloseInLane)
+    {
+        ref_v = std::max(ref_v - 0.224, 0.0);
+
+        if(!m_lane_change_initiated)
+        {
+            changeFsmState(fsmStates::prepareLaneChange);
+
+            tryLaneShift(lane_num, foundBest ? &best : nullptr, tooCloseOnLeft, tooCloseOnRight);
+        }
+    }
+    // If not too close then increase speed to reach maximum allowed limit
+    else if(ref_v < 49)
+    {
+        ref_v += 0.224;
+    }
+    // When maximum allowed speed limit reached then keep the lane
+    else
+    {
+        changeFsmState(fsmStates::keepLane);
+        m_lane_change_wait = 0;
+    }
+
+    // The path follows the cheapest feasible candidate in the lane the FSM
+    // settled on, its target speed and its horizon. The reference speed goes
+    // no higher than the candidate's but still only ramps up as above, and
+    // stands in alone when that lane has none
+    CandidateChoice follow;
+    bool following = m_candidates.bestInLane(lane_num, follow);
+    if(following)
+    {
+        ref_v = std::min(ref_v, follow.speed * 2.24);
+        m_log.write<logDebug>(logFollowedCandidate, follow.lane, follow.speed, follow.horizon, follow.cost);
+    }
+
+    Clock::time_point decided = Clock::now();
+
+    // Fill the rest of the points after filling prev points, each one 0.02 s further
+    // along the curve. The speed follows the reference with bounded acceleration
+    // and jerk, no faster than lets the car stop behind the one ahead, in the lane
+    // it is in at the end of the previous path and in the one it is heading for. In
+    // a lane it is still leaving, a car up to followGap behind the end of the
+    // previous path counts as ahead, the car has not cleared it yet
+    double target_v = ref_v / 2.24;
+    int end_lane = vehicles.laneOf((prev_size > 0) ? end_path_d : car_d);
+    int lanes_ahead[3] = {lane_num, end_lane, vehicles.laneOf(car_d)};
+    for(int k = 0; k < 3; k++)
+    {
+        int lane = lanes_ahead[k];
+        double behind = (k == 2 && lane != end_lane) ? followGap : 0;
+        double gap;
+        int ahead = (lane >= 0) ? vehicles.leader(lane, car_s - behind, gap) : -1;
+        if(ahead >= 0)
+        {
+            double room = std::max(gap - behind - followGap, 0.0);
+            target_v = std::min(target_v, sqrt(vehicles.speed(ahead) * vehicles.speed(ahead) + 2 * followBrake * room));
+        }
+    }
+
+    int fill_size = 0;
+    for(int i = 1; i < pathPoints - prev_size; i++)
+    {
+        double wanted = std::min(std::max(speedGain * (target_v - v), -maxPathAccel), maxPathAccel);
+        a += std::min(std::max(wanted - a, -maxPathJerk * 0.02), maxPathJerk * 0.02);
+        v += a * 0.02;
+        if(v < 0)
+        {
+            v = 0;
+            a = 0;
+        }
+        m_fill_v[fill_size] = v;
+        m_fill_a[fill_size] = a;
+        m_fill_step[fill_size++] = 0.02 * v;
+    }
+
+    std::vector<double> &pts_x = m_pts_x;
+    std::vector<double> &pts_y = m_pts_y;
+    pts_x.clear();
+    pts_y.clear();
+
+    // The reference point and the one before it must differ for the fit,
+    // which they need not while the car stands still
+    int ref_prev = prev_size - 2;
+    while(ref_prev >= 0 && previous_path_x[ref_prev] == previous_path_x[prev_size - 1] &&
+          previous_path_y[ref_prev] == previous_path_y[prev_size - 1])
+    {
+        ref_prev--;
+    }
+
+    // if previous size is almost empty, use the car as starting reference
+    if(ref_prev < 0)
+    {
+        // Use two points that make the path tangent to the car
+        double car_prev_x = car_x - cos(car_yaw);
+        double car_prev_y = car_y - sin(car_yaw);
+
+        pts_x.push_back(car_prev_x);
+        pts_x.push_back(car_x);
+
+        pts_y.push_back(car_prev_y);
+        pts_y.push_back(car_y);
+    }
+    else
+    {
+        double ref_x = previous_path_x[prev_size - 1];
+        double ref_y = previous_path_y[prev_size - 1];
+
+        double ref_prev_x = previous_path_x[ref_prev];
+        double ref_prev_y = previous_path_y[ref_prev];
+
+        // Use two points that make the path tangent to the previous path's end point
+        pts_x.push_back(ref_prev_x);
+        pts_x.push_back(ref_x);
+
+        pts_y.push_back(ref_prev_y);
+        pts_y.push_back(ref_y);
+    }
+
+    // In frenet add evenly spaced anchors ahead of the starting reference, 30 m
+    // apart or, when the followed candidate changes lanes, as far as it takes
+    // to reach its lane. Wider spacings are tried when the path through them is
+    // too sharp at the planned speed; when none keeps the limits, the one
+    // closest to them is sent
+    bool junction = (prev_size > 0);
+    int spacings = sizeof(anchorSpacings) / sizeof(anchorSpacings[0]);
+    double spacing = anchorSpacings[0];
+    if(following && follow.lane != vehicles.laneOf(egoD.p))
+    {
+        spacing = 0.5 * (egoS.v + follow.speed) * follow.horizon;
+        spacing = std::min(std::max(spacing, anchorSpacings[0]), anchorSpacings[spacings - 1]);
+    }
+    double best_spacing = spacing, last_spacing = spacing;
+    double best_excess = 0;
+    int k = 0;
+    bool first = true;
+    for(;;)
+    {
+        last_spacing = spacing;
+        double excess = fitPath(car_s, lane_num, spacing, fill_size, junction);
+        if(first || excess < best_excess)
+        {
+            best_spacing = spacing;
+            best_excess = excess;
+        }
+        first = false;
+        // Next listed spacing wider than this one
+        while(k < spacings && anchorSpacings[k] <= spacing)
+        {
+            k++;
+        }
+        if(excess <= ((spacing < m_spacing) ? narrowExcess : 1) || k == spacings)
+        {
+            break;
+        }
+        spacing = anchorSpacings[k];
+    }
+    if(best_spacing != last_spacing)
+    {
+        fitPath(car_s, lane_num, best_spacing, fill_size, junction);
+    }
+    if(best_spacing > anchorSpacings[0] || best_excess > 1)
+    {
+        m_log.write<logDebug>(logPathRefit, best_spacing, best_excess);
+    }
+    m_spacing = best_spacing;
+
+    m_end_v = v;
+    m_end_a = a;
+    if(fill_size > 0)
+    {
+        m_end_kappa = m_fill_kappa[fill_size - 1];
+    }
+    Clock::time_point fitted = Clock::now();
+
+    std::vector<double> &next_x_vals = m_next_x_vals;
+    std::vector<double> &next_y_vals = m_next_y_vals;
+    next_x_vals.clear();
+    next_y_vals.clear();
+
+    // Start with the previous path points from last time
+    for(int i = 0; i < prev_size; i++)
+    {
+        next_x_vals.push_back(previous_path_x[i]);
+        next_y_vals.push_back(previous_path_y[i]);
+    }
+
+    for(int i = 0; i < fill_size; i++)
+    {
+        next_x_vals.push_back(m_fill_x[i]);
+        next_y_vals.push_back(m_fill_y[i]);
+    }
+
+    Clock::time_point planned = Clock::now();
+
+    // The path made up of (x,y) points that the car will visit sequentially every .02 seconds
+    control_message::write(next_x_vals.data(), next_y_vals.data(), next_x_vals.size(), reply);
+
+    planningAllocations.expectNone("Planning cycle");
+
+    m_stage_times.plan_ms = std::chrono::duration<double, std::milli>(planned - start).count();
+    m_stage_times.vehicles_ms = std::chrono::duration<double, std::milli>(decoded - start).count();
+    m_stage_times.decide_ms = std::chrono::duration<double, std::milli>(decided - decoded).count();
+    m_stage_times.fit_ms = std::chrono::duration<double, std::milli>(fitted - decided).count();
+    m_stage_times.points_ms = std::chrono::duration<double, std::milli>(planned - fitted).count();
+    m_stage_times.serialize_ms = std::chrono::duration<double, std::milli>(Clock::now() - planned).count();
+    m_cycles++;
+}
+
+#endif /* PLANNER_SESSION_H */
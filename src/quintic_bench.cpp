@@ -0,0 +1,169 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "quintic_trajectory.h"
+#include "candidate_planner.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/****************************************************************/
+/* The per-candidate solve the batch replaced: the 3x3 boundary system
+ * set up and solved by Gaussian elimination for every trajectory */
+/****************************************************************/
+static void solveScalar(const QuinticState &start, const QuinticState &end, double t, double *coeff)
+{
+    double t2 = t * t, t3 = t2 * t, t4 = t3 * t, t5 = t4 * t;
+    double m[3][4] = {
+        {t3, t4, t5, end.p - (start.p + start.v * t + 0.5 * start.a * t2)},
+        {3 * t2, 4 * t3, 5 * t4, end.v - (start.v + start.a * t)},
+        {6 * t, 12 * t2, 20 * t3, end.a - start.a}};
+    for(int col = 0; col < 3; col++)
+    {
+        for(int row = col + 1; row < 3; row++)
+        {
+            double f = m[row][col] / m[col][col];
+            for(int k = col; k < 4; k++)
+            {
+                m[row][k] -= f * m[col][k];
+            }
+        }
+    }
+    for(int row = 2; row >= 0; row--)
+    {
+        double x = m[row][3];
+        for(int k = row + 1; k < 3; k++)
+        {
+            x -= m[row][k] * coeff[3 + k];
+        }
+        coeff[3 + row] = x / m[row][row];
+    }
+    coeff[0] = start.p;
+    coeff[1] = start.v;
+    coeff[2] = 0.5 * start.a;
+}
+
+// Worst boundary mismatch of a state, relative to the positions involved
+static double mismatch(const QuinticState &got, const QuinticState &want, double scale)
+{
+    double worst = max(fabs(got.p - want.p), max(fabs(got.v - want.v), fabs(got.a - want.a)));
+    return worst / scale;
+}
+
+/****************************************************************/
+/* Checks that every QuinticBatch candidate starts and ends in the
+ * states it was asked for, position, velocity and acceleration on both
+ * axes at t = 0 and t = T, on random states over the planner's
+ * horizons. Then times cycles of the CandidatePlanner grid, 3 lanes x
+ * 12 speeds x 14 horizons, against the per-candidate Gaussian solve.
+ * Fails on a boundary mismatch above 1e-9: quintic_bench [cycles] */
+/****************************************************************/
+int main(int argc, char *argv[])
+{
+    int cycles = (argc > 1) ? atoi(argv[1]) : 2000;
+
+    CandidateConfig config;
+    QuinticHorizons horizons;
+    for(int h = 0; h < config.horizons; h++)
+    {
+        horizons.add(config.min_horizon + h * config.horizon_step);
+    }
+    int grid = config.lanes * config.speeds * config.horizons;
+
+    mt19937 random(1);
+    uniform_real_distribution<double> position(0, 7000), speed(0, 22), accel(-5, 5);
+    uniform_real_distribution<double> lateral(0, 12), lateral_speed(-2, 2), lateral_accel(-2, 2);
+    uniform_int_distribution<int> horizon(0, horizons.size() - 1);
+
+    QuinticBatch batch(horizons);
+    batch.reserve(grid);
+    vector<QuinticState> s_start, s_end, d_start, d_end;
+    for(int i = 0; i < grid; i++)
+    {
+        QuinticState s0 = {position(random), speed(random), accel(random)};
+        QuinticState s1 = {s0.p + position(random) / 20, speed(random), accel(random)};
+        QuinticState d0 = {lateral(random), lateral_speed(random), lateral_accel(random)};
+        QuinticState d1 = {lateral(random), lateral_speed(random), lateral_accel(random)};
+        batch.add(s0, s1, d0, d1, horizon(random));
+        s_start.push_back(s0);
+        s_end.push_back(s1);
+        d_start.push_back(d0);
+        d_end.push_back(d1);
+    }
+    batch.solve();
+
+    double worst = 0;
+    for(int i = 0; i < batch.size(); i++)
+    {
+        double t = batch.horizon(i);
+        double s_scale = 1 + fabs(s_start[i].p) + fabs(s_end[i].p);
+        double d_scale = 1 + fabs(d_start[i].p) + fabs(d_end[i].p);
+        worst = max(worst, mismatch(batch.s(i, 0), s_start[i], s_scale));
+        worst = max(worst, mismatch(batch.s(i, t), s_end[i], s_scale));
+        worst = max(worst, mismatch(batch.d(i, 0), d_start[i], d_scale));
+        worst = max(worst, mismatch(batch.d(i, t), d_end[i], d_scale));
+    }
+
+    // The planner's grid from one ego state per cycle
+    QuinticState ego_s = {124.8, 20.5, 0.3};
+    QuinticState ego_d = {6.1, 0.1, 0};
+    double sink = 0;
+    Clock::time_point start = Clock::now();
+    for(int c = 0; c < cycles; c++)
+    {
+        batch.clear();
+        for(int lane = 0; lane < config.lanes; lane++)
+        {
+            QuinticState lane_end = {config.lane_width * (lane + 0.5), 0, 0};
+            for(int k = 0; k < config.speeds; k++)
+            {
+                double target = config.max_speed * (k + 1) / config.speeds;
+                for(int h = 0; h < horizons.size(); h++)
+                {
+                    QuinticState speed_end = {ego_s.p + 0.5 * (ego_s.v + target) * horizons.horizon(h), target, 0};
+                    batch.add(ego_s, speed_end, ego_d, lane_end, h);
+                }
+            }
+        }
+        batch.solve();
+        sink += batch.sCoeff(c % grid, 5);
+        ego_s.p += 0.4;
+    }
+    double batch_ms = chrono::duration<double, milli>(Clock::now() - start).count();
+
+    double coeff_s[6], coeff_d[6];
+    start = Clock::now();
+    for(int c = 0; c < cycles; c++)
+    {
+        for(int lane = 0; lane < config.lanes; lane++)
+        {
+            QuinticState lane_end = {config.lane_width * (lane + 0.5), 0, 0};
+            for(int k = 0; k < config.speeds; k++)
+            {
+                double target = config.max_speed * (k + 1) / config.speeds;
+                for(int h = 0; h < horizons.size(); h++)
+                {
+                    double t = horizons.horizon(h);
+                    QuinticState speed_end = {ego_s.p + 0.5 * (ego_s.v + target) * t, target, 0};
+                    solveScalar(ego_s, speed_end, t, coeff_s);
+                    solveScalar(ego_d, lane_end, t, coeff_d);
+                    sink += coeff_s[5] + coeff_d[5];
+                }
+            }
+        }
+        ego_s.p += 0.4;
+    }
+    double scalar_ms = chrono::duration<double, milli>(Clock::now() - start).count();
+
+    bool exact = worst <= 1e-9;
+    cout << grid << " random candidates, worst boundary mismatch at t = 0 and t = T " << worst
+         << (exact ? "" : " (too large)") << endl;
+    cout << cycles << " cycles of " << grid << " candidates: batch " << cycles * grid / batch_ms
+         << " candidates/ms, Gaussian solve per candidate " << cycles * grid / scalar_ms << " candidates/ms "
+         << scalar_ms / batch_ms << "x" << (sink == 0 ? " " : "") << endl;
+    return exact ? 0 : 1;
+}
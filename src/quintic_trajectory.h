@@ -0,0 +1,210 @@
+#ifndef QUINTIC_TRAJECTORY_H
+#define QUINTIC_TRAJECTORY_H
+
+#include <assert.h>
+#include <vector>
+
+/****************************************************************/
+/* Position, velocity and acceleration along one Frenet axis */
+/****************************************************************/
+struct QuinticState
+{
+    double p;
+    double v;
+    double a;
+};
+
+/****************************************************************/
+/* Horizons T the generator plans over, each with the inverse of the
+ * 3x3 boundary matrix
+ *
+ *   | T^3    T^4     T^5   |
+ *   | 3T^2   4T^3    5T^4  |
+ *   | 6T     12T^2   20T^3 |
+ *
+ * in closed form, so solving for the upper three coefficients of a
+ * jerk-minimizing quintic is a 3x3 matrix-vector product */
+/****************************************************************/
+class QuinticHorizons
+{
+public:
+    void add(double horizon);
+
+    int size() const { return m_t.size(); }
+    double horizon(int h) const { return m_t[h]; }
+    // Row major inverse of the boundary matrix for horizon h
+    const double *inverse(int h) const { return &m_inv[9 * h]; }
+
+private:
+    std::vector<double> m_t;
+    std::vector<double> m_inv;
+};
+
+inline void QuinticHorizons::add(double horizon)
+{
+    assert(horizon > 0);
+    double t = horizon;
+    double t2 = t * t;
+    double t3 = t2 * t;
+    double t4 = t3 * t;
+    double t5 = t4 * t;
+    const double inv[9] = {
+        10 / t3, -4 / t2, 1 / (2 * t),
+        -15 / t4, 7 / t3, -1 / t2,
+        6 / t5, -3 / t4, 1 / (2 * t3)
+    };
+    m_t.push_back(horizon);
+    m_inv.insert(m_inv.end(), inv, inv + 9);
+}
+
+/****************************************************************/
+/* Batch of quintic trajectories s(t), d(t) in structure-of-arrays
+ * layout. Candidates are queued with add(), solve() then computes all
+ * coefficients in one pass over plain columns, a loop the compiler can
+ * vectorize. With reserve() called up front a planning cycle reuses
+ * the columns and does not allocate */
+/****************************************************************/
+class QuinticBatch
+{
+public:
+    explicit QuinticBatch(const QuinticHorizons &horizons) : m_horizons(horizons) {}
+
+    void reserve(int capacity);
+    void clear();
+
+    // Queues a candidate from the start to the end state on both axes
+    // over the given horizon index, returns its index
+    int add(const QuinticState &s_start, const QuinticState &s_end,
+            const QuinticState &d_start, const QuinticState &d_end, int horizon);
+
+    // Coefficients of every queued candidate
+    void solve();
+
+    int size() const { return m_horizon.size(); }
+    double horizon(int i) const { return m_horizons.horizon(m_horizon[i]); }
+
+    // Coefficient k of candidate i, s(t) = sum c_k t^k
+    double sCoeff(int i, int k) const { return m_s_coeff[k][i]; }
+    double dCoeff(int i, int k) const { return m_d_coeff[k][i]; }
+
+    // Position, velocity and acceleration of candidate i at time t
+    QuinticState s(int i, double t) const { return evaluate(m_s_coeff, i, t); }
+    QuinticState d(int i, double t) const { return evaluate(m_d_coeff, i, t); }
+
+private:
+    struct Column
+    {
+        std::vector<double> p, v, a;
+    };
+
+    void push(Column &column, const QuinticState &state);
+    void solveAxis(const Column &start, const Column &end, std::vector<double> (&coeff)[6]);
+    QuinticState evaluate(const std::vector<double> (&coeff)[6], int i, double t) const;
+
+    const QuinticHorizons &m_horizons;
+    Column m_s_start, m_s_end, m_d_start, m_d_end;
+    std::vector<int> m_horizon;
+    std::vector<double> m_s_coeff[6];
+    std::vector<double> m_d_coeff[6];
+};
+
+inline void QuinticBatch::reserve(int capacity)
+{
+    Column *columns[] = {&m_s_start, &m_s_end, &m_d_start, &m_d_end};
+    for(Column *column : columns)
+    {
+        column->p.reserve(capacity);
+        column->v.reserve(capacity);
+        column->a.reserve(capacity);
+    }
+    m_horizon.reserve(capacity);
+    for(int k = 0; k < 6; k++)
+    {
+        m_s_coeff[k].reserve(capacity);
+        m_d_coeff[k].reserve(capacity);
+    }
+}
+
+inline void QuinticBatch::clear()
+{
+    Column *columns[] = {&m_s_start, &m_s_end, &m_d_start, &m_d_end};
+    for(Column *column : columns)
+    {
+        column->p.clear();
+        column->v.clear();
+        column->a.clear();
+    }
+    m_horizon.clear();
+}
+
+inline void QuinticBatch::push(Column &column, const QuinticState &state)
+{
+    column.p.push_back(state.p);
+    column.v.push_back(state.v);
+    column.a.push_back(state.a);
+}
+
+inline int QuinticBatch::add(const QuinticState &s_start, const QuinticState &s_end,
+                             const QuinticState &d_start, const QuinticState &d_end, int horizon)
+{
+    assert(horizon >= 0 && horizon < m_horizons.size());
+    push(m_s_start, s_start);
+    push(m_s_end, s_end);
+    push(m_d_start, d_start);
+    push(m_d_end, d_end);
+    m_horizon.push_back(horizon);
+    return m_horizon.size() - 1;
+}
+
+inline void QuinticBatch::solveAxis(const Column &start, const Column &end, std::vector<double> (&coeff)[6])
+{
+    int n = m_horizon.size();
+    for(int k = 0; k < 6; k++)
+    {
+        coeff[k].resize(n);
+    }
+
+    const double *p0 = start.p.data(), *v0 = start.v.data(), *a0 = start.a.data();
+    const double *p1 = end.p.data(), *v1 = end.v.data(), *a1 = end.a.data();
+    const int *horizon = m_horizon.data();
+    double *c0 = coeff[0].data(), *c1 = coeff[1].data(), *c2 = coeff[2].data();
+    double *c3 = coeff[3].data(), *c4 = coeff[4].data(), *c5 = coeff[5].data();
+    for(int i = 0; i < n; i++)
+    {
+        double t = m_horizons.horizon(horizon[i]);
+        const double *inv = m_horizons.inverse(horizon[i]);
+
+        // The start state fixes the lower three coefficients, the rest has to
+        // close the gap to the end state left by them at t = T
+        c0[i] = p0[i];
+        c1[i] = v0[i];
+        c2[i] = 0.5 * a0[i];
+        double r_p = p1[i] - (p0[i] + (v0[i] + 0.5 * a0[i] * t) * t);
+        double r_v = v1[i] - (v0[i] + a0[i] * t);
+        double r_a = a1[i] - a0[i];
+
+        c3[i] = inv[0] * r_p + inv[1] * r_v + inv[2] * r_a;
+        c4[i] = inv[3] * r_p + inv[4] * r_v + inv[5] * r_a;
+        c5[i] = inv[6] * r_p + inv[7] * r_v + inv[8] * r_a;
+    }
+}
+
+inline void QuinticBatch::solve()
+{
+    solveAxis(m_s_start, m_s_end, m_s_coeff);
+    solveAxis(m_d_start, m_d_end, m_d_coeff);
+}
+
+inline QuinticState QuinticBatch::evaluate(const std::vector<double> (&coeff)[6], int i, double t) const
+{
+    double c0 = coeff[0][i], c1 = coeff[1][i], c2 = coeff[2][i];
+    double c3 = coeff[3][i], c4 = coeff[4][i], c5 = coeff[5][i];
+
+    QuinticState state;
+    state.p = ((((c5 * t + c4) * t + c3) * t + c2) * t + c1) * t + c0;
+    state.v = (((5 * c5 * t + 4 * c4) * t + 3 * c3) * t + 2 * c2) * t + c1;
+    state.a = ((20 * c5 * t + 12 * c4) * t + 6 * c3) * t + 2 * c2;
+    return state;
+}
+
+#endif /* QUINTIC_TRAJECTORY_H */
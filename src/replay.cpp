@@ -0,0 +1,189 @@
+#include <stdint.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include "highway_map.h"
+#include "dense_track.h"
+#include "map_file.h"
+#include "frame_log.h"
+#include "latency_histogram.h"
+#include "planner_log.h"
+#include "planner_metrics.h"
+#include "planner_session.h"
+
+using namespace std;
+
+/****************************************************************/
+/* One recorded connection: its planner and the replies it made that
+ * are still waiting for the recorded reply to compare with */
+/****************************************************************/
+struct ReplayedConnection
+{
+    unique_ptr<PlannerSession> session;
+    map<uint64_t, string> replies;
+};
+
+static void printHistogram(const char *stage, const LatencyHistogram &histogram)
+{
+    printf("%-10s %8llu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n", stage, (unsigned long long)histogram.count(),
+           histogram.meanUs(), histogram.percentileUs(0.5), histogram.percentileUs(0.9),
+           histogram.percentileUs(0.99), histogram.percentileUs(0.999), histogram.maxUs());
+}
+
+/****************************************************************/
+/* Feeds the frames of a log recorded with path_planning --record
+ * through the planner sessions as fast as they go, one session per
+ * recorded connection, and reports the throughput, the latency of
+ * each planning stage and how many replies differ from the recorded
+ * ones. The candidates are otherwise scored for a wall clock budget on
+ * the worker pool, so a reply depends on how fast its frame was
+ * planned: 0 replies differ only for a log recorded with
+ * path_planning --deterministic and replayed with --deterministic,
+ * which both score every candidate in order on one thread. Frames the
+ * server dropped under load are planned here too, so their later
+ * replies can differ even then. The planner only logs with --verbose:
+ * path_planning_replay frames.log [--deterministic] [--verbose] */
+/****************************************************************/
+int main(int argc, char *argv[])
+{
+    string log_file;
+    bool verbose = false;
+    bool deterministic = false;
+    for(int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if(arg == "--verbose")
+        {
+            verbose = true;
+        }
+        else if(arg == "--deterministic")
+        {
+            deterministic = true;
+        }
+        else if(log_file.empty())
+        {
+            log_file = arg;
+        }
+    }
+    if(log_file.empty())
+    {
+        cerr << "Usage: " << argv[0] << " frames.log [--deterministic] [--verbose]" << endl;
+        return -1;
+    }
+
+    // Same map as the server
+    string map_bin_ = "../data/highway_map.bin";
+    string map_file_ = "../data/highway_map.csv";
+    DenseTrack track;
+    MapFile map_data;
+    string map_error;
+    if(!map_data.loadTrack(map_bin_, map_file_, track, map_error))
+    {
+        cerr << "Failed to read waypoints from " << map_file_ << endl;
+        return -1;
+    }
+
+    FrameLogReader reader;
+    string error;
+    if(!reader.open(log_file, error))
+    {
+        cerr << "Failed to open " << log_file << ": " << error << endl;
+        return -1;
+    }
+
+    WorkerPool workers(deterministic ? 1 : 0);
+    CandidateConfig candidateConfig;
+    candidateConfig.track_length = track.maxS();
+    if(deterministic)
+    {
+        candidateConfig.budget_ms = 0;
+    }
+
+    // The planner logs only when asked to
+    unique_ptr<Logger> logger;
+    if(verbose)
+    {
+        logger.reset(new Logger);
+    }
+
+    std::map<uint32_t, ReplayedConnection> connections;
+    // Only the planning stages and the whole frame apply to a replay
+    std::unique_ptr<PlannerMetrics> metrics(new PlannerMetrics);
+    uint64_t received = 0, recorded_replies = 0, compared = 0, differ = 0;
+    string reply;
+
+    typedef chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    LoggedFrame logged;
+    while(reader.next(logged, error))
+    {
+        ReplayedConnection &connection = connections[logged.connection];
+        if(!connection.session)
+        {
+            connection.session.reset(new PlannerSession(track, workers, candidateConfig));
+            if(logger)
+            {
+                connection.session->attachLog(*logger, logged.connection);
+            }
+        }
+
+        if(logged.kind == frameReceived)
+        {
+            received++;
+            uint64_t cycles_before = connection.session->cycles();
+            Clock::time_point frame_start = Clock::now();
+            bool replied = connection.session->onMessage(logged.data, logged.size, reply);
+            metrics->recordMs(stageFrame, chrono::duration<double, milli>(Clock::now() - frame_start).count());
+            if(connection.session->cycles() != cycles_before)
+            {
+                metrics->recordCycle(connection.session->stageTimes());
+            }
+            if(replied)
+            {
+                connection.replies[logged.sequence].swap(reply);
+            }
+        }
+        else if(logged.kind == frameSent)
+        {
+            recorded_replies++;
+            auto replayed = connection.replies.find(logged.sequence);
+            if(replayed != connection.replies.end())
+            {
+                compared++;
+                if(replayed->second.size() != logged.size
+                   || replayed->second.compare(0, logged.size, logged.data, logged.size) != 0)
+                {
+                    differ++;
+                }
+                // Replies to older frames were dropped by the server
+                connection.replies.erase(connection.replies.begin(), ++replayed);
+            }
+        }
+    }
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    // Writes out the rest of the planner log before the results
+    size_t connection_count = connections.size();
+    connections.clear();
+    logger.reset();
+    if(!error.empty())
+    {
+        cerr << "Log ends early: " << error << endl;
+    }
+
+    printf("%llu frames from %zu connections, %llu planning cycles in %.3f s: %.0f frames/s\n",
+           (unsigned long long)received, connection_count, (unsigned long long)metrics->planning_cycles, seconds,
+           seconds > 0 ? received / seconds : 0.0);
+    printf("%llu recorded replies, %llu compared, %llu differ\n", (unsigned long long)recorded_replies,
+           (unsigned long long)compared, (unsigned long long)differ);
+    printf("%-10s %8s %9s %9s %9s %9s %9s %9s\n", "stage us", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for(int stage = stageParse; stage <= stageSerialize; stage++)
+    {
+        printHistogram(plannerStageNames[stage], metrics->stages[stage]);
+    }
+    printHistogram(plannerStageNames[stageFrame], metrics->stages[stageFrame]);
+    return 0;
+}
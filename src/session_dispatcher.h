@@ -0,0 +1,422 @@
+#ifndef SESSION_DISPATCHER_H
+#define SESSION_DISPATCHER_H
+
+#include <uWS/uWS.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame_log.h"
+#include "latest_mailbox.h"
+#include "planner_metrics.h"
+#include "planner_session.h"
+
+/****************************************************************/
+/* Frame counts and latency from a frame being received to its reply
+ * being sent, in ms. Frames dropped were replaced by a newer one before
+ * being planned, or planned but replaced before their reply went out */
+/****************************************************************/
+struct DispatchStats
+{
+    uint64_t received = 0;
+    uint64_t dropped = 0;
+    uint64_t sent = 0;
+    double latency_sum_ms = 0;
+    double latency_max_ms = 0;
+
+    void addSent(double latency_ms)
+    {
+        sent++;
+        latency_sum_ms += latency_ms;
+        latency_max_ms = std::max(latency_max_ms, latency_ms);
+    }
+    double meanLatencyMs() const { return sent ? latency_sum_ms / sent : 0; }
+};
+
+/****************************************************************/
+/* A received frame or the reply planned from it, stamped with the time
+ * the frame came in */
+/****************************************************************/
+struct Frame
+{
+    std::string data;
+    std::chrono::steady_clock::time_point received;
+    uint64_t sequence = 0;              // of the frame on its connection
+};
+
+/****************************************************************/
+/* One simulator connection: its planner session, the websocket the
+ * replies go to and the frames on their way through the dispatcher.
+ * Bound to the websocket as its user data */
+/****************************************************************/
+struct Connection
+{
+    Connection(uint32_t id, uWS::WebSocket<uWS::SERVER> ws, PlannerSession *session) : id(id), ws(ws), session(session) {}
+
+    uint32_t id;
+    uWS::WebSocket<uWS::SERVER> ws;
+    std::unique_ptr<PlannerSession> session;
+
+    // Frames from the event loop to the planning thread
+    LatestMailbox<Frame> frames;
+
+    // Guarded by the dispatcher mutex
+    Frame reply;                    // planned, not yet sent
+    bool has_reply = false;
+    bool scheduled = false;         // queued or being planned
+    bool in_done = false;           // in the list of the event loop
+    bool closed = false;
+    Connection *next_ready = nullptr;
+    Connection *next_done = nullptr;
+    DispatchStats stats;
+
+    // Owned by the thread planning the connection
+    Frame building;
+
+    // Owned by the event loop
+    std::string sending;
+    uint64_t frames_posted = 0;
+};
+
+/****************************************************************/
+/* Plans the sessions of all connections on a fixed set of threads, so
+ * many simulator instances can be driven by one process while the
+ * uWS event loop only moves frames. A connection is planned by one
+ * thread at a time and always from the newest frame: frames go through
+ * a latest-wins mailbox, so under load stale telemetry is dropped rather
+ * than queued. Finished replies are handed back through an async wakeup
+ * and sent on the event loop, the only thread allowed to touch the
+ * websockets */
+/****************************************************************/
+class SessionDispatcher
+{
+public:
+    // threads 0 picks one per core
+    explicit SessionDispatcher(uS::Loop *loop, int threads = 0);
+    ~SessionDispatcher();
+    SessionDispatcher(const SessionDispatcher &) = delete;
+    SessionDispatcher &operator=(const SessionDispatcher &) = delete;
+
+    // Event loop only: queues a received frame of the connection
+    void post(Connection *connection, const char *data, size_t length);
+    // Event loop only: drops the connection, right away or once the frame
+    // being planned for it is done
+    void close(Connection *connection);
+
+    // Counts of one connection, and of all connections so far
+    DispatchStats stats(Connection *connection);
+    DispatchStats totals();
+    // Merges the stage latencies and counters of all connections so far
+    void metrics(PlannerMetrics &out);
+
+    // Event loop only: appends every frame received and reply sent to the
+    // log from now on, nullptr to stop
+    void record(FrameLogWriter *log) { m_log = log; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // Metrics of one thread. Only the scrape contends for the mutex
+    struct MetricsSlot
+    {
+        std::mutex mutex;
+        PlannerMetrics metrics;
+    };
+
+    void schedule(Connection *connection);
+    static void onReplies(uS::Async *async);
+    void sendReplies();
+    void work(MetricsSlot *slot);
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+    Connection *m_ready_head = nullptr;
+    Connection *m_ready_tail = nullptr;
+    Connection *m_done_head = nullptr;
+    DispatchStats m_totals;
+
+    // One for the event loop, then one per planning thread, allocated apart
+    // so that no two threads write the same cache lines
+    std::vector<std::unique_ptr<MetricsSlot> > m_metrics;
+
+    uS::Async *m_async;
+    std::vector<std::thread> m_threads;
+    FrameLogWriter *m_log = nullptr;
+};
+
+inline SessionDispatcher::SessionDispatcher(uS::Loop *loop, int threads)
+{
+    m_async = new uS::Async(loop);
+    m_async->setData(this);
+    m_async->start(&SessionDispatcher::onReplies);
+
+    if(threads <= 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+    threads = std::max(threads, 1);
+    for(int i = 0; i <= threads; i++)
+    {
+        m_metrics.push_back(std::unique_ptr<MetricsSlot>(new MetricsSlot));
+    }
+    for(int i = 0; i < threads; i++)
+    {
+        m_threads.push_back(std::thread(&SessionDispatcher::work, this, m_metrics[i + 1].get()));
+    }
+}
+
+inline SessionDispatcher::~SessionDispatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for(std::thread &thread : m_threads)
+    {
+        thread.join();
+    }
+    // Frees itself once the loop has let go of it
+    m_async->close();
+}
+
+inline void SessionDispatcher::schedule(Connection *connection)
+{
+    connection->scheduled = true;
+    connection->next_ready = nullptr;
+    if(m_ready_tail != nullptr)
+    {
+        m_ready_tail->next_ready = connection;
+    }
+    else
+    {
+        m_ready_head = connection;
+    }
+    m_ready_tail = connection;
+}
+
+inline void SessionDispatcher::post(Connection *connection, const char *data, size_t length)
+{
+    Clock::time_point start = Clock::now();
+    Frame &frame = connection->frames.back();
+    frame.data.assign(data, length);
+    frame.received = Clock::now();
+    frame.sequence = ++connection->frames_posted;
+    if(m_log != nullptr)
+    {
+        m_log->append(frameReceived, connection->id, frame.sequence, data, length);
+    }
+    bool replaced = connection->frames.publish();
+    double receive_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    {
+        std::lock_guard<std::mutex> lock(m_metrics[0]->mutex);
+        m_metrics[0]->metrics.recordMs(stageReceive, receive_ms);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    connection->stats.received++;
+    m_totals.received++;
+    if(replaced)
+    {
+        connection->stats.dropped++;
+        m_totals.dropped++;
+    }
+    if(connection->scheduled)
+    {
+        return;
+    }
+    schedule(connection);
+    lock.unlock();
+    m_wake.notify_one();
+}
+
+inline void SessionDispatcher::close(Connection *connection)
+{
+    if(connection == nullptr)
+    {
+        return;
+    }
+    if(m_log != nullptr)
+    {
+        m_log->flush();
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    connection->closed = true;
+    bool idle = !connection->scheduled && !connection->in_done;
+    lock.unlock();
+    if(idle)
+    {
+        delete connection;
+    }
+}
+
+inline void SessionDispatcher::work(MetricsSlot *slot)
+{
+    for(;;)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [this] { return m_stop || m_ready_head != nullptr; });
+        if(m_stop)
+        {
+            return;
+        }
+        Connection *connection = m_ready_head;
+        m_ready_head = connection->next_ready;
+        if(m_ready_head == nullptr)
+        {
+            m_ready_tail = nullptr;
+        }
+        lock.unlock();
+
+        bool has_reply = false;
+        bool taken = connection->frames.take();
+        PlannerSession &session = *connection->session;
+        uint64_t cycles = session.cycles();
+        uint64_t manual_frames = session.manualFrames();
+        uint64_t lane_changes = session.laneChanges();
+        double queue_ms = 0;
+        if(taken)
+        {
+            const Frame &frame = connection->frames.front();
+            queue_ms = std::chrono::duration<double, std::milli>(Clock::now() - frame.received).count();
+            has_reply = session.onMessage(frame.data.data(), frame.data.size(), connection->building.data);
+            connection->building.received = frame.received;
+            connection->building.sequence = frame.sequence;
+
+            std::lock_guard<std::mutex> metrics_lock(slot->mutex);
+            PlannerMetrics &metrics = slot->metrics;
+            metrics.recordMs(stageQueue, queue_ms);
+            if(session.cycles() != cycles)
+            {
+                metrics.recordCycle(session.stageTimes());
+            }
+            metrics.manual_frames += session.manualFrames() - manual_frames;
+            metrics.lane_changes += session.laneChanges() - lane_changes;
+        }
+
+        lock.lock();
+        if(has_reply)
+        {
+            if(connection->has_reply)
+            {
+                connection->stats.dropped++;
+                m_totals.dropped++;
+            }
+            std::swap(connection->reply, connection->building);
+            connection->has_reply = true;
+        }
+        if(connection->frames.pending() && !connection->closed)
+        {
+            // A newer frame came in meanwhile, plan it next in turn
+            schedule(connection);
+            m_wake.notify_one();
+        }
+        else
+        {
+            connection->scheduled = false;
+        }
+        bool wakeLoop = false;
+        if(!connection->in_done && (connection->has_reply || connection->closed))
+        {
+            connection->in_done = true;
+            connection->next_done = m_done_head;
+            m_done_head = connection;
+            wakeLoop = true;
+        }
+        lock.unlock();
+        if(wakeLoop)
+        {
+            m_async->send();
+        }
+    }
+}
+
+inline DispatchStats SessionDispatcher::stats(Connection *connection)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return connection->stats;
+}
+
+inline DispatchStats SessionDispatcher::totals()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_totals;
+}
+
+inline void SessionDispatcher::metrics(PlannerMetrics &out)
+{
+    out.reset();
+    for(const std::unique_ptr<MetricsSlot> &slot : m_metrics)
+    {
+        std::lock_guard<std::mutex> lock(slot->mutex);
+        out.merge(slot->metrics);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    out.frames_received = m_totals.received;
+    out.frames_dropped = m_totals.dropped;
+    out.replies_sent = m_totals.sent;
+}
+
+inline void SessionDispatcher::onReplies(uS::Async *async)
+{
+    static_cast<SessionDispatcher *>(async->getData())->sendReplies();
+}
+
+inline void SessionDispatcher::sendReplies()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Connection *connection = m_done_head;
+    m_done_head = nullptr;
+    while(connection != nullptr)
+    {
+        Connection *next = connection->next_done;
+        double frame_ms = 0;
+        connection->in_done = false;
+        bool send = connection->has_reply && !connection->closed;
+        uint64_t sequence = connection->reply.sequence;
+        if(send)
+        {
+            connection->sending.swap(connection->reply.data);
+            connection->has_reply = false;
+            double latency = std::chrono::duration<double, std::milli>(Clock::now() - connection->reply.received).count();
+            connection->stats.addSent(latency);
+            m_totals.addSent(latency);
+            frame_ms = latency;
+        }
+        bool release = connection->closed && !connection->scheduled;
+        lock.unlock();
+
+        double send_ms = 0;
+        if(send)
+        {
+            Clock::time_point start = Clock::now();
+            connection->ws.send(connection->sending.data(), connection->sending.length(), uWS::OpCode::TEXT);
+            send_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            if(m_log != nullptr)
+            {
+                m_log->append(frameSent, connection->id, sequence, connection->sending.data(), connection->sending.length());
+            }
+        }
+        if(release)
+        {
+            delete connection;
+        }
+        if(send)
+        {
+            std::lock_guard<std::mutex> metrics_lock(m_metrics[0]->mutex);
+            m_metrics[0]->metrics.recordMs(stageFrame, frame_ms);
+            m_metrics[0]->metrics.recordMs(stageSend, send_ms);
+        }
+
+        lock.lock();
+        connection = next;
+    }
+}
+
+#endif /* SESSION_DISPATCHER_H */
@@ -0,0 +1,214 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <uWS/uWS.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "highway_map.h"
+#include "dense_track.h"
+#include "map_file.h"
+#include "latency_histogram.h"
+#include "planner_log.h"
+#include "planner_session.h"
+#include "highway_sim.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/****************************************************************/
+/* Runs the planner against HighwaySim in closed loop and reports how
+ * it drove. In process the frames go straight to a PlannerSession, as
+ * fast as it plans; with --ws the simulator connects to a running
+ * path_planning over the websocket like the real one, but waits for
+ * each reply instead of keeping wall clock time. --frenet-noise adds
+ * noise of the given standard deviation to the traffic's s,d, which the
+ * planner in process re-derives from x,y with --rederive-frenet. With
+ * --deterministic it scores every candidate in order on one thread, so
+ * a seed always drives the same way. The planner in process only logs
+ * with --verbose:
+ * path_planning_sim [--seconds N] [--vehicles N] [--seed N]
+ *                   [--ticks-per-frame N] [--frenet-noise M] [--rederive-frenet]
+ *                   [--deterministic] [--ws ws://localhost:4567] [--verbose] */
+/****************************************************************/
+int main(int argc, char *argv[])
+{
+    SimConfig config;
+    double sim_seconds = 300;
+    string uri;
+    bool verbose = false;
+    bool rederive = false;
+    bool deterministic = false;
+    for(int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if(arg == "--seconds" && has_value)
+        {
+            sim_seconds = atof(argv[++i]);
+        }
+        else if(arg == "--vehicles" && has_value)
+        {
+            config.vehicles = atoi(argv[++i]);
+        }
+        else if(arg == "--seed" && has_value)
+        {
+            config.seed = strtoul(argv[++i], nullptr, 10);
+        }
+        else if(arg == "--ticks-per-frame" && has_value)
+        {
+            config.ticks_per_frame = std::max(atoi(argv[++i]), 1);
+        }
+        else if(arg == "--frenet-noise" && has_value)
+        {
+            config.frenet_noise = atof(argv[++i]);
+        }
+        else if(arg == "--rederive-frenet")
+        {
+            rederive = true;
+        }
+        else if(arg == "--deterministic")
+        {
+            deterministic = true;
+        }
+        else if(arg == "--ws" && has_value)
+        {
+            uri = argv[++i];
+        }
+        else if(arg == "--verbose")
+        {
+            verbose = true;
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--seconds N] [--vehicles N] [--seed N] [--ticks-per-frame N]"
+                 << " [--frenet-noise M] [--rederive-frenet] [--deterministic] [--ws ws://localhost:4567]"
+                 << " [--verbose]" << endl;
+            return -1;
+        }
+    }
+
+    // Same map as the server
+    string map_bin_ = "../data/highway_map.bin";
+    string map_file_ = "../data/highway_map.csv";
+    HighwayMap map;
+    DenseTrack track;
+    MapFile map_data;
+    string map_error;
+    if(!map_data.load(map_bin_, map_file_, map, track, map_error))
+    {
+        cerr << "Failed to read waypoints from " << map_file_ << endl;
+        return -1;
+    }
+
+    HighwaySim sim(map, track, config);
+    if(sim.vehicles() < config.vehicles)
+    {
+        cerr << "Only " << sim.vehicles() << " of " << config.vehicles << " vehicles fit on the road" << endl;
+        return -1;
+    }
+    uint64_t frames = (uint64_t)(sim_seconds / 0.02 / config.ticks_per_frame);
+    // Time from handing out a frame to having its reply
+    LatencyHistogram latency;
+    string frame, reply;
+    bool failed = false;
+
+    unique_ptr<Logger> logger;
+    if(verbose)
+    {
+        logger.reset(new Logger);
+    }
+
+    Clock::time_point start = Clock::now();
+    if(uri.empty())
+    {
+        WorkerPool workers(deterministic ? 1 : 0);
+        CandidateConfig candidateConfig;
+        candidateConfig.track_length = track.maxS();
+        if(deterministic)
+        {
+            candidateConfig.budget_ms = 0;
+        }
+        PlannerSession session(track, workers, candidateConfig);
+        if(rederive)
+        {
+            session.rederiveFrenet(map);
+        }
+        if(logger)
+        {
+            session.attachLog(*logger, 1);
+        }
+
+        for(uint64_t i = 0; i < frames && !failed; i++)
+        {
+            sim.telemetry(frame);
+            Clock::time_point sent = Clock::now();
+            failed = !session.onMessage(frame.data(), frame.size(), reply);
+            latency.recordMs(chrono::duration<double, milli>(Clock::now() - sent).count());
+            failed = failed || !sim.control(reply.data(), reply.size());
+        }
+    }
+    else
+    {
+        uWS::Hub h;
+        Clock::time_point sent;
+        bool connected = false;
+
+        h.onConnection([&](uWS::WebSocket<uWS::CLIENT> ws, uWS::HttpRequest req) {
+            connected = true;
+            sim.telemetry(frame);
+            sent = Clock::now();
+            ws.send(frame.data(), frame.size(), uWS::OpCode::TEXT);
+        });
+
+        h.onMessage([&](uWS::WebSocket<uWS::CLIENT> ws, char *data, size_t length, uWS::OpCode opCode) {
+            latency.recordMs(chrono::duration<double, milli>(Clock::now() - sent).count());
+            if(!sim.control(data, length))
+            {
+                failed = true;
+                ws.close();
+                return;
+            }
+            if(sim.report().frames >= frames)
+            {
+                ws.close();
+                return;
+            }
+            sim.telemetry(frame);
+            sent = Clock::now();
+            ws.send(frame.data(), frame.size(), uWS::OpCode::TEXT);
+        });
+
+        h.onError([&](void *user) {
+            failed = true;
+        });
+
+        h.connect(uri, nullptr);
+        h.run();
+        failed = failed || !connected;
+    }
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    // Writes out the rest of the planner log before the report
+    logger.reset();
+    if(failed)
+    {
+        cerr << (uri.empty() ? "Planner" : uri) << " stopped replying after " << sim.report().frames << " frames" << endl;
+    }
+
+    const SimReport &report = sim.report();
+    printf("%.1f s simulated with %d vehicles in %.3f s: %.0f frames/s, %.0f ticks/s\n", report.seconds(),
+           config.vehicles, seconds, seconds > 0 ? report.frames / seconds : 0.0,
+           seconds > 0 ? report.ticks / seconds : 0.0);
+    printf("distance %.1f m, average speed %.2f mph, max speed %.2f mph\n", report.distance,
+           report.averageSpeedMph(), report.max_speed * 2.24);
+    printf("collisions %d, off road %d, over speed limit %d, ticks without path %llu\n", report.collisions,
+           report.off_road, report.speed_violations, (unsigned long long)report.starved_ticks);
+    printf("acceleration over %.0f m/s2 %d (max %.2f), jerk over %.0f m/s3 %d (max %.2f)\n", config.max_accel,
+           report.accel_violations, report.max_accel, config.max_jerk, report.jerk_violations, report.max_jerk);
+    printf("reply us: mean %.1f, p50 %.1f, p99 %.1f, max %.1f\n", latency.meanUs(), latency.percentileUs(0.5),
+           latency.percentileUs(0.99), latency.maxUs());
+    return failed ? 1 : 0;
+}
@@ -29,15 +29,15 @@
 
 #include <cstdio>
 #include <cassert>
+#include <cmath>
 #include <vector>
+#include <array>
 #include <algorithm>
 
 
-// unnamed namespace only because the implementation is in this
-// header file and we don't want to export symbols to the obj files
-namespace
-{
-
+// the non-template members are inline, so the header can be included
+// from several obj files and classes holding tk types keep external
+// linkage
 namespace tk
 {
 
@@ -45,21 +45,40 @@ namespace tk
 class band_matrix
 {
 private:
-    std::vector< std::vector<double> > m_upper;  // upper band
-    std::vector< std::vector<double> > m_lower;  // lower band
+    // all bands in one block, dim() entries each: upper bands 0..n_u
+    // (0 is the diagonal) followed by lower bands 0..n_l (0 is the saved
+    // diagonal), so a band is a contiguous run
+    std::vector<double> m_data;
+    int m_dim, m_n_u, m_n_l;
+    double* upper_band(int k)
+    {
+        return &m_data[k*m_dim];
+    }
+    const double* upper_band(int k) const
+    {
+        return &m_data[k*m_dim];
+    }
+    double* lower_band(int k)
+    {
+        return &m_data[(m_n_u+1+k)*m_dim];
+    }
+    const double* lower_band(int k) const
+    {
+        return &m_data[(m_n_u+1+k)*m_dim];
+    }
 public:
-    band_matrix() {};                             // constructor
+    band_matrix(): m_dim(0), m_n_u(0), m_n_l(0) {};  // constructor
     band_matrix(int dim, int n_u, int n_l);       // constructor
     ~band_matrix() {};                            // destructor
     void resize(int dim, int n_u, int n_l);      // init with dim,n_u,n_l
     int dim() const;                             // matrix dimension
     int num_upper() const
     {
-        return m_upper.size()-1;
+        return m_n_u;
     }
     int num_lower() const
     {
-        return m_lower.size()-1;
+        return m_n_l;
     }
     // access operator
     double & operator () (int i, int j);            // write
@@ -68,10 +87,18 @@ public:
     double& saved_diag(int i);
     double  saved_diag(int i) const;
     void lu_decompose();
-    std::vector<double> r_solve(const std::vector<double>& b) const;
-    std::vector<double> l_solve(const std::vector<double>& b) const;
-    std::vector<double> lu_solve(const std::vector<double>& b,
-                                 bool is_lu_decomposed=false);
+    // solve into x, lu_solve() using y as scratch; neither allocates once
+    // the vectors have reached dim()
+    void r_solve(const std::vector<double>& b, std::vector<double>& x) const;
+    void l_solve(const std::vector<double>& b, std::vector<double>& x) const;
+    void lu_solve(const std::vector<double>& b, std::vector<double>& x,
+                  std::vector<double>& y, bool is_lu_decomposed=false);
+    // solves the freshly assembled system into x, with work as a scratch
+    // vector kept by the caller across fits; a tridiagonal matrix takes
+    // the Thomas algorithm and is left untouched, any other one is
+    // overwritten by its LU decomposition
+    void solve_into(const std::vector<double>& b, std::vector<double>& x,
+                    std::vector<double>& work);
 
 };
 
@@ -94,6 +121,10 @@ private:
     bd_type m_left, m_right;
     double  m_left_value, m_right_value;
     bool    m_force_linear_extrapolation;
+    // equation system, kept so refitting does not allocate
+    band_matrix m_A;
+    std::vector<double> m_rhs, m_tmp;
+    std::vector<double> m_dd_max, m_ddd_max;    // per segment bounds
 
 public:
     // set default boundary condition to be zero curvature at both ends
@@ -111,80 +142,436 @@ public:
     void set_points(const std::vector<double>& x,
                     const std::vector<double>& y, bool cubic_spline=true);
     double operator() (double x) const;
+    // evaluates f at the non-decreasing positions xs[0..n-1], and f', f''
+    // as well where dys, ddys are given; walks a segment cursor instead of
+    // searching for every point
+    void eval_sorted(const double* xs, double* ys, size_t n,
+                     double* dys=NULL, double* ddys=NULL) const;
+    // same with strides, counted in doubles, between consecutive values
+    void eval_sorted_strided(const double* xs, size_t x_stride,
+                             double* ys, size_t y_stride, size_t n,
+                             double* dys=NULL, double* ddys=NULL,
+                             size_t d_stride=1) const;
+    // derivative of the given order, 1 to 3, at x
+    double deriv(int order, double x) const;
+    // curvature f''/(1+f'^2)^(3/2) at the non-decreasing positions xs[0..n-1]
+    void curvature_sorted(const double* xs, double* kappa, size_t n) const;
+    // max |f''| and |f'''| on the segment [x_i, x_i+1], exact since f'' is
+    // linear there, computed at fit time
+    double max_abs_deriv2(size_t i) const
+    {
+        return m_dd_max[i];
+    }
+    double max_abs_deriv3(size_t i) const
+    {
+        return m_ddd_max[i];
+    }
+    // max |f''| (order 2) or |f'''| (order 3) between the first and the
+    // last point, a pass over the segment bounds
+    double max_abs_deriv(int order) const;
+};
+
+
+
+// cubic spline through a compile-time number of points, all storage is
+// inline and the tridiagonal system is solved in place with the Thomas
+// algorithm, so fitting and evaluating never touch the heap
+template <size_t N>
+class fixed_spline
+{
+public:
+    typedef spline::bd_type bd_type;
+
+private:
+    std::array<double,N> m_x,m_y;           // x,y coordinates of points
+    // f(x) = a*(x-x_i)^3 + b*(x-x_i)^2 + c*(x-x_i) + y_i
+    std::array<double,N> m_a,m_b,m_c;       // spline coefficients
+    double  m_b0, m_c0;                     // for left extrapol
+    bd_type m_left, m_right;
+    double  m_left_value, m_right_value;
+    bool    m_force_linear_extrapolation;
+    std::array<double,N> m_dd_max,m_ddd_max;    // per segment bounds
+
+public:
+    // set default boundary condition to be zero curvature at both ends
+    fixed_spline(): m_left(spline::second_deriv), m_right(spline::second_deriv),
+        m_left_value(0.0), m_right_value(0.0),
+        m_force_linear_extrapolation(false)
+    {
+        static_assert(N>2, "a cubic spline needs at least 3 points");
+    }
+
+    // optional, applies to every following set_points()
+    void set_boundary(bd_type left, double left_value,
+                      bd_type right, double right_value,
+                      bool force_linear_extrapolation=false);
+    void set_points(const double* x, const double* y);
+    void set_points(const std::vector<double>& x,
+                    const std::vector<double>& y)
+    {
+        assert(x.size()==N && y.size()==N);
+        set_points(x.data(), y.data());
+    }
+    double operator() (double x) const;
+    // evaluates f at the non-decreasing positions xs[0..n-1], and f', f''
+    // as well where dys, ddys are given; walks a segment cursor instead of
+    // searching for every point
+    void eval_sorted(const double* xs, double* ys, size_t n,
+                     double* dys=NULL, double* ddys=NULL) const;
+    // same with strides, counted in doubles, between consecutive values
+    void eval_sorted_strided(const double* xs, size_t x_stride,
+                             double* ys, size_t y_stride, size_t n,
+                             double* dys=NULL, double* ddys=NULL,
+                             size_t d_stride=1) const;
+    // derivative of the given order, 1 to 3, at x
+    double deriv(int order, double x) const;
+    // curvature f''/(1+f'^2)^(3/2) at the non-decreasing positions xs[0..n-1]
+    void curvature_sorted(const double* xs, double* kappa, size_t n) const;
+    // max |f''| and |f'''| on the segment [x_i, x_i+1], exact since f'' is
+    // linear there, computed at fit time
+    double max_abs_deriv2(size_t i) const
+    {
+        return m_dd_max[i];
+    }
+    double max_abs_deriv3(size_t i) const
+    {
+        return m_ddd_max[i];
+    }
+    // max |f''| (order 2) or |f'''| (order 3) between the first and the
+    // last point, a pass over the segment bounds
+    double max_abs_deriv(int order) const;
 };
 
 
+// parametric cubic spline through a compile-time number of 2-D points:
+// x(t) and y(t) are fitted over the cumulative chord length t with zero
+// curvature at both ends, so the points only need to be distinct, not
+// increasing in x; both axes share one factorization of the tridiagonal
+// system and are evaluated together
+template <size_t N>
+class spline2d
+{
+private:
+    std::array<double,N> m_t;               // chord length at each point
+    std::array<double,N> m_x,m_y;           // x,y coordinates of points
+    // x(t) = ax*(t-t_i)^3 + bx*(t-t_i)^2 + cx*(t-t_i) + x_i, y(t) alike
+    std::array<double,N> m_ax,m_bx,m_cx;
+    std::array<double,N> m_ay,m_by,m_cy;
+    std::array<double,N> m_dd_max,m_ddd_max;    // per segment bounds
+
+    // coefficients of one axis from its values v[] and second derivative
+    // terms b[], which are already in place
+    void set_coefficients(const std::array<double,N>& v,
+                          std::array<double,N>& a, const std::array<double,N>& b,
+                          std::array<double,N>& c);
+
+public:
+    spline2d()
+    {
+        static_assert(N>2, "a cubic spline needs at least 3 points");
+    }
+
+    void set_points(const double* x, const double* y);
+    // parameter t of point i, t=0 at the first point
+    double t_at(size_t i) const
+    {
+        return m_t[i];
+    }
+    void operator() (double t, double& x, double& y) const;
+    // evaluates x(t), y(t) at the non-decreasing parameters ts[0..n-1], and
+    // their first and second derivatives as well where those are given
+    void eval_sorted(const double* ts, double* xs, double* ys, size_t n,
+                     double* dxs=NULL, double* dys=NULL,
+                     double* ddxs=NULL, double* ddys=NULL) const;
+    // derivative of the given order, 1 to 3, of x(t) and y(t) at t
+    void deriv(int order, double t, double& dx, double& dy) const;
+    // signed curvature (x'y''-y'x'')/(x'^2+y'^2)^(3/2) at the non-decreasing
+    // parameters ts[0..n-1], positive turning left
+    void curvature_sorted(const double* ts, double* kappa, size_t n) const;
+    // segment [t_i, t_i+1] holding t, 0 before the first point and N-2
+    // past the last one
+    size_t segment(double t) const;
+    // max |P''| and |P'''| of P(t)=(x(t),y(t)) on segment i, exact for
+    // P''' and an upper bound for P'', which is linear there and so peaks
+    // at one of the ends; computed at fit time
+    double max_abs_deriv2(size_t i) const
+    {
+        return m_dd_max[i];
+    }
+    double max_abs_deriv3(size_t i) const
+    {
+        return m_ddd_max[i];
+    }
+};
+
 
 // ---------------------------------------------------------------------
 // implementation part, which could be separated into a cpp file
 // ---------------------------------------------------------------------
 
 
+// batch evaluation shared by spline and fixed_spline: a segment cursor
+// walks the sorted positions, each block gathers the coefficients of its
+// points and then runs Horner's scheme over plain arrays, a loop the
+// compiler can vectorize
+inline void eval_sorted_impl(const double* px, const double* py,
+                             const double* pa, const double* pb, const double* pc,
+                             int n_pts, double b0, double c0,
+                             const double* xs, size_t x_stride,
+                             double* ys, size_t y_stride, size_t n,
+                             double* dys, double* ddys, size_t d_stride)
+{
+    const size_t block=64;
+    double a[block], b[block], c[block], y[block], h[block];
+    int idx=0;
+    for(size_t start=0; start<n; start+=block) {
+        size_t len=std::min(block, n-start);
+        for(size_t k=0; k<len; k++) {
+            double x=xs[(start+k)*x_stride];
+            // closest point px[idx] < x, idx=0 even if x<px[0]
+            while(idx+1<n_pts && px[idx+1]<x) idx++;
+            h[k]=x-px[idx];
+            y[k]=py[idx];
+            if(x<px[0]) {
+                // extrapolation to the left
+                a[k]=0.0;
+                b[k]=b0;
+                c[k]=c0;
+            } else {
+                // interpolation, and extrapolation to the right with a=0
+                a[k]=pa[idx];
+                b[k]=pb[idx];
+                c[k]=pc[idx];
+            }
+        }
+        double* out=ys+start*y_stride;
+        for(size_t k=0; k<len; k++) {
+            out[k*y_stride]=((a[k]*h[k] + b[k])*h[k] + c[k])*h[k] + y[k];
+        }
+        if(dys!=NULL) {
+            double* d1=dys+start*d_stride;
+            for(size_t k=0; k<len; k++) {
+                d1[k*d_stride]=(3.0*a[k]*h[k] + 2.0*b[k])*h[k] + c[k];
+            }
+        }
+        if(ddys!=NULL) {
+            double* d2=ddys+start*d_stride;
+            for(size_t k=0; k<len; k++) {
+                d2[k*d_stride]=6.0*a[k]*h[k] + 2.0*b[k];
+            }
+        }
+    }
+}
+
+
+// derivative of the given order, shared by spline and fixed_spline
+inline double deriv_impl(int order, double x, const double* px,
+                         const double* pa, const double* pb, const double* pc,
+                         int n_pts, double b0, double c0)
+{
+    assert(order>0);
+    // find the closest point px[idx] < x, idx=0 even if x<px[0]
+    const double* it=std::lower_bound(px,px+n_pts,x);
+    int idx=std::max( int(it-px)-1, 0);
+
+    double h=x-px[idx];
+    double interpol;
+    if(x<px[0]) {
+        // extrapolation to the left
+        switch(order) {
+        case 1:
+            interpol=2.0*b0*h + c0;
+            break;
+        case 2:
+            interpol=2.0*b0;
+            break;
+        default:
+            interpol=0.0;
+            break;
+        }
+    } else if(x>px[n_pts-1]) {
+        // extrapolation to the right
+        switch(order) {
+        case 1:
+            interpol=2.0*pb[n_pts-1]*h + pc[n_pts-1];
+            break;
+        case 2:
+            interpol=2.0*pb[n_pts-1];
+            break;
+        default:
+            interpol=0.0;
+            break;
+        }
+    } else {
+        // interpolation
+        switch(order) {
+        case 1:
+            interpol=(3.0*pa[idx]*h + 2.0*pb[idx])*h + pc[idx];
+            break;
+        case 2:
+            interpol=6.0*pa[idx]*h + 2.0*pb[idx];
+            break;
+        case 3:
+            interpol=6.0*pa[idx];
+            break;
+        default:
+            interpol=0.0;
+            break;
+        }
+    }
+    return interpol;
+}
+
+// per segment bounds of |f''| and |f'''|: f''=6a*h+2b is linear on a
+// segment, so it peaks at one of the ends, and f'''=6a is constant
+inline void deriv_bounds_impl(const double* px, const double* pa,
+                              const double* pb, int n_pts,
+                              double* dd_max, double* ddd_max)
+{
+    for(int i=0; i<n_pts-1; i++) {
+        double h=px[i+1]-px[i];
+        dd_max[i]=std::max(std::fabs(2.0*pb[i]),
+                           std::fabs(6.0*pa[i]*h + 2.0*pb[i]));
+        ddd_max[i]=std::fabs(6.0*pa[i]);
+    }
+}
+
+inline double max_abs_deriv_impl(int order, const double* dd_max,
+                                 const double* ddd_max, int n_pts)
+{
+    assert(order==2 || order==3);
+    const double* bound=(order==2) ? dd_max : ddd_max;
+    double result=0.0;
+    for(int i=0; i<n_pts-1; i++) {
+        result=std::max(result, bound[i]);
+    }
+    return result;
+}
+
+// curvature on top of the batch evaluation, one stack block at a time
+template <typename S>
+void curvature_sorted_impl(const S& s, const double* xs, double* kappa,
+                           size_t n)
+{
+    const size_t block=64;
+    double y[block], dy[block], ddy[block];
+    for(size_t start=0; start<n; start+=block) {
+        size_t len=std::min(block, n-start);
+        s.eval_sorted(xs+start, y, len, dy, ddy);
+        for(size_t k=0; k<len; k++) {
+            double slope=1.0 + dy[k]*dy[k];
+            kappa[start+k]=ddy[k]/(slope*std::sqrt(slope));
+        }
+    }
+}
+
+
+// Thomas algorithm for lower[i]*x[i-1] + diag[i]*x[i] + upper[i]*x[i+1]
+// = rhs[i], i=0..n-1, lower[0] and upper[n-1] are ignored; the eliminated
+// upper diagonal goes to the scratch c[], the inputs are not modified
+inline void thomas_solve(int n, const double* lower, const double* diag,
+                         const double* upper, const double* rhs,
+                         double* x, double* c)
+{
+    assert(diag[0]!=0.0);
+    c[0]=upper[0]/diag[0];
+    x[0]=rhs[0]/diag[0];
+    for(int i=1; i<n; i++) {
+        double pivot=diag[i]-lower[i]*c[i-1];
+        assert(pivot!=0.0);
+        c[i]=upper[i]/pivot;
+        x[i]=(rhs[i]-lower[i]*x[i-1])/pivot;
+    }
+    for(int i=n-2; i>=0; i--) {
+        x[i]-=c[i]*x[i+1];
+    }
+}
+
+// the same split in two, so several right hand sides can share one
+// elimination: thomas_factor() fills c[] and the pivots, thomas_apply()
+// then solves for one rhs[] with the same arithmetic as thomas_solve()
+inline void thomas_factor(int n, const double* lower, const double* diag,
+                          const double* upper, double* c, double* pivot)
+{
+    assert(diag[0]!=0.0);
+    pivot[0]=diag[0];
+    c[0]=upper[0]/pivot[0];
+    for(int i=1; i<n; i++) {
+        pivot[i]=diag[i]-lower[i]*c[i-1];
+        assert(pivot[i]!=0.0);
+        c[i]=upper[i]/pivot[i];
+    }
+}
+inline void thomas_apply(int n, const double* lower, const double* c,
+                         const double* pivot, const double* rhs, double* x)
+{
+    x[0]=rhs[0]/pivot[0];
+    for(int i=1; i<n; i++) {
+        x[i]=(rhs[i]-lower[i]*x[i-1])/pivot[i];
+    }
+    for(int i=n-2; i>=0; i--) {
+        x[i]-=c[i]*x[i+1];
+    }
+}
+
+
 // band_matrix implementation
 // -------------------------
 
-band_matrix::band_matrix(int dim, int n_u, int n_l)
+inline band_matrix::band_matrix(int dim, int n_u, int n_l)
 {
     resize(dim, n_u, n_l);
 }
-void band_matrix::resize(int dim, int n_u, int n_l)
+inline void band_matrix::resize(int dim, int n_u, int n_l)
 {
     assert(dim>0);
     assert(n_u>=0);
     assert(n_l>=0);
-    m_upper.resize(n_u+1);
-    m_lower.resize(n_l+1);
-    for(size_t i=0; i<m_upper.size(); i++) {
-        m_upper[i].resize(dim);
-    }
-    for(size_t i=0; i<m_lower.size(); i++) {
-        m_lower[i].resize(dim);
-    }
+    m_dim=dim;
+    m_n_u=n_u;
+    m_n_l=n_l;
+    m_data.assign((n_u+n_l+2)*dim,0.0);
 }
-int band_matrix::dim() const
+inline int band_matrix::dim() const
 {
-    if(m_upper.size()>0) {
-        return m_upper[0].size();
-    } else {
-        return 0;
-    }
+    return m_dim;
 }
 
 
 // defines the new operator (), so that we can access the elements
 // by A(i,j), index going from i=0,...,dim()-1
-double & band_matrix::operator () (int i, int j)
+inline double & band_matrix::operator () (int i, int j)
 {
     int k=j-i;       // what band is the entry
     assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
     assert( (-num_lower()<=k) && (k<=num_upper()) );
     // k=0 -> diogonal, k<0 lower left part, k>0 upper right part
-    if(k>=0)   return m_upper[k][i];
-    else	    return m_lower[-k][i];
+    if(k>=0)   return upper_band(k)[i];
+    else	    return lower_band(-k)[i];
 }
-double band_matrix::operator () (int i, int j) const
+inline double band_matrix::operator () (int i, int j) const
 {
     int k=j-i;       // what band is the entry
     assert( (i>=0) && (i<dim()) && (j>=0) && (j<dim()) );
     assert( (-num_lower()<=k) && (k<=num_upper()) );
     // k=0 -> diogonal, k<0 lower left part, k>0 upper right part
-    if(k>=0)   return m_upper[k][i];
-    else	    return m_lower[-k][i];
+    if(k>=0)   return upper_band(k)[i];
+    else	    return lower_band(-k)[i];
 }
 // second diag (used in LU decomposition), saved in m_lower
-double band_matrix::saved_diag(int i) const
+inline double band_matrix::saved_diag(int i) const
 {
     assert( (i>=0) && (i<dim()) );
-    return m_lower[0][i];
+    return lower_band(0)[i];
 }
-double & band_matrix::saved_diag(int i)
+inline double & band_matrix::saved_diag(int i)
 {
     assert( (i>=0) && (i<dim()) );
-    return m_lower[0][i];
+    return lower_band(0)[i];
 }
 
 // LR-Decomposition of a band matrix
-void band_matrix::lu_decompose()
+inline void band_matrix::lu_decompose()
 {
     int  i_max,j_max;
     int  j_min;
@@ -219,10 +606,10 @@ void band_matrix::lu_decompose()
     }
 }
 // solves Ly=b
-std::vector<double> band_matrix::l_solve(const std::vector<double>& b) const
+inline void band_matrix::l_solve(const std::vector<double>& b, std::vector<double>& x) const
 {
     assert( this->dim()==(int)b.size() );
-    std::vector<double> x(this->dim());
+    x.resize(this->dim());
     int j_start;
     double sum;
     for(int i=0; i<this->dim(); i++) {
@@ -231,13 +618,12 @@ std::vector<double> band_matrix::l_solve(const std::vector<double>& b) const
         for(int j=j_start; j<i; j++) sum += this->operator()(i,j)*x[j];
         x[i]=(b[i]*this->saved_diag(i)) - sum;
     }
-    return x;
 }
 // solves Rx=y
-std::vector<double> band_matrix::r_solve(const std::vector<double>& b) const
+inline void band_matrix::r_solve(const std::vector<double>& b, std::vector<double>& x) const
 {
     assert( this->dim()==(int)b.size() );
-    std::vector<double> x(this->dim());
+    x.resize(this->dim());
     int j_stop;
     double sum;
     for(int i=this->dim()-1; i>=0; i--) {
@@ -246,20 +632,30 @@ std::vector<double> band_matrix::r_solve(const std::vector<double>& b) const
         for(int j=i+1; j<=j_stop; j++) sum += this->operator()(i,j)*x[j];
         x[i]=( b[i] - sum ) / this->operator()(i,i);
     }
-    return x;
 }
 
-std::vector<double> band_matrix::lu_solve(const std::vector<double>& b,
-        bool is_lu_decomposed)
+inline void band_matrix::lu_solve(const std::vector<double>& b, std::vector<double>& x,
+                                  std::vector<double>& y, bool is_lu_decomposed)
 {
     assert( this->dim()==(int)b.size() );
-    std::vector<double>  x,y;
     if(is_lu_decomposed==false) {
         this->lu_decompose();
     }
-    y=this->l_solve(b);
-    x=this->r_solve(y);
-    return x;
+    this->l_solve(b,y);
+    this->r_solve(y,x);
+}
+inline void band_matrix::solve_into(const std::vector<double>& b, std::vector<double>& x,
+                                    std::vector<double>& work)
+{
+    assert( this->dim()==(int)b.size() );
+    if(m_n_u==1 && m_n_l==1) {
+        x.resize(m_dim);
+        work.resize(m_dim);
+        thomas_solve(m_dim,lower_band(1),upper_band(0),upper_band(1),
+                     b.data(),x.data(),work.data());
+    } else {
+        lu_solve(b,x,work);
+    }
 }
 
 
@@ -268,9 +664,9 @@ std::vector<double> band_matrix::lu_solve(const std::vector<double>& b,
 // spline implementation
 // -----------------------
 
-void spline::set_boundary(spline::bd_type left, double left_value,
-                          spline::bd_type right, double right_value,
-                          bool force_linear_extrapolation)
+inline void spline::set_boundary(spline::bd_type left, double left_value,
+                                 spline::bd_type right, double right_value,
+                                 bool force_linear_extrapolation)
 {
     assert(m_x.size()==0);          // set_points() must not have happened yet
     m_left=left;
@@ -281,8 +677,8 @@ void spline::set_boundary(spline::bd_type left, double left_value,
 }
 
 
-void spline::set_points(const std::vector<double>& x,
-                        const std::vector<double>& y, bool cubic_spline)
+inline void spline::set_points(const std::vector<double>& x,
+                               const std::vector<double>& y, bool cubic_spline)
 {
     assert(x.size()==y.size());
     assert(x.size()>2);
@@ -297,8 +693,10 @@ void spline::set_points(const std::vector<double>& x,
     if(cubic_spline==true) { // cubic spline interpolation
         // setting up the matrix and right hand side of the equation system
         // for the parameters b[]
-        band_matrix A(n,1,1);
-        std::vector<double>  rhs(n);
+        band_matrix& A=m_A;
+        std::vector<double>& rhs=m_rhs;
+        A.resize(n,1,1);
+        rhs.assign(n,0.0);
         for(int i=1; i<n-1; i++) {
             A(i,i-1)=1.0/3.0*(x[i]-x[i-1]);
             A(i,i)=2.0/3.0*(x[i+1]-x[i-1]);
@@ -306,26 +704,20 @@ void spline::set_points(const std::vector<double>& x,
             rhs[i]=(y[i+1]-y[i])/(x[i+1]-x[i]) - (y[i]-y[i-1])/(x[i]-x[i-1]);
         }
         // boundary conditions
-        if(m_left == spline::second_deriv) {
-            // 2*b[0] = f''
-            A(0,0)=2.0;
-            A(0,1)=0.0;
-            rhs[0]=m_left_value;
-        } else if(m_left == spline::first_deriv) {
+        if(m_left == spline::first_deriv) {
             // c[0] = f', needs to be re-expressed in terms of b:
             // (2b[0]+b[1])(x[1]-x[0]) = 3 ((y[1]-y[0])/(x[1]-x[0]) - f')
             A(0,0)=2.0*(x[1]-x[0]);
             A(0,1)=1.0*(x[1]-x[0]);
             rhs[0]=3.0*((y[1]-y[0])/(x[1]-x[0])-m_left_value);
         } else {
-            assert(false);
+            assert(m_left == spline::second_deriv);
+            // 2*b[0] = f''
+            A(0,0)=2.0;
+            A(0,1)=0.0;
+            rhs[0]=m_left_value;
         }
-        if(m_right == spline::second_deriv) {
-            // 2*b[n-1] = f''
-            A(n-1,n-1)=2.0;
-            A(n-1,n-2)=0.0;
-            rhs[n-1]=m_right_value;
-        } else if(m_right == spline::first_deriv) {
+        if(m_right == spline::first_deriv) {
             // c[n-1] = f', needs to be re-expressed in terms of b:
             // (b[n-2]+2b[n-1])(x[n-1]-x[n-2])
             // = 3 (f' - (y[n-1]-y[n-2])/(x[n-1]-x[n-2]))
@@ -333,11 +725,15 @@ void spline::set_points(const std::vector<double>& x,
             A(n-1,n-2)=1.0*(x[n-1]-x[n-2]);
             rhs[n-1]=3.0*(m_right_value-(y[n-1]-y[n-2])/(x[n-1]-x[n-2]));
         } else {
-            assert(false);
+            assert(m_right == spline::second_deriv);
+            // 2*b[n-1] = f''
+            A(n-1,n-1)=2.0;
+            A(n-1,n-2)=0.0;
+            rhs[n-1]=m_right_value;
         }
 
         // solve the equation system to obtain the parameters b[]
-        m_b=A.lu_solve(rhs);
+        A.solve_into(rhs,m_b,m_tmp);
 
         // calculate parameters a[] and c[] based on b[]
         m_a.resize(n);
@@ -370,9 +766,14 @@ void spline::set_points(const std::vector<double>& x,
     m_c[n-1]=3.0*m_a[n-2]*h*h+2.0*m_b[n-2]*h+m_c[n-2];   // = f'_{n-2}(x_{n-1})
     if(m_force_linear_extrapolation==true)
         m_b[n-1]=0.0;
+
+    m_dd_max.resize(n);
+    m_ddd_max.resize(n);
+    deriv_bounds_impl(m_x.data(),m_a.data(),m_b.data(),n,
+                      m_dd_max.data(),m_ddd_max.data());
 }
 
-double spline::operator() (double x) const
+inline double spline::operator() (double x) const
 {
     size_t n=m_x.size();
     // find the closest point m_x[idx] < x, idx=0 even if x<m_x[0]
@@ -396,9 +797,357 @@ double spline::operator() (double x) const
 }
 
 
-} // namespace tk
+inline void spline::eval_sorted(const double* xs, double* ys, size_t n,
+                                double* dys, double* ddys) const
+{
+    eval_sorted_strided(xs,1,ys,1,n,dys,ddys,1);
+}
+
+inline void spline::eval_sorted_strided(const double* xs, size_t x_stride,
+                                        double* ys, size_t y_stride, size_t n,
+                                        double* dys, double* ddys, size_t d_stride) const
+{
+    eval_sorted_impl(m_x.data(),m_y.data(),m_a.data(),m_b.data(),m_c.data(),
+                     m_x.size(),m_b0,m_c0,xs,x_stride,ys,y_stride,n,
+                     dys,ddys,d_stride);
+}
+
+inline double spline::deriv(int order, double x) const
+{
+    return deriv_impl(order,x,m_x.data(),m_a.data(),m_b.data(),m_c.data(),
+                      m_x.size(),m_b0,m_c0);
+}
+
+inline void spline::curvature_sorted(const double* xs, double* kappa, size_t n) const
+{
+    curvature_sorted_impl(*this,xs,kappa,n);
+}
+
+inline double spline::max_abs_deriv(int order) const
+{
+    return max_abs_deriv_impl(order,m_dd_max.data(),m_ddd_max.data(),
+                              m_x.size());
+}
+
+// fixed_spline implementation
+// -----------------------
+
+template <size_t N>
+void fixed_spline<N>::set_boundary(bd_type left, double left_value,
+                                   bd_type right, double right_value,
+                                   bool force_linear_extrapolation)
+{
+    m_left=left;
+    m_right=right;
+    m_left_value=left_value;
+    m_right_value=right_value;
+    m_force_linear_extrapolation=force_linear_extrapolation;
+}
+
+template <size_t N>
+void fixed_spline<N>::set_points(const double* x, const double* y)
+{
+    const int n=N;
+    for(int i=0; i<n; i++) {
+        m_x[i]=x[i];
+        m_y[i]=y[i];
+    }
+    for(int i=0; i<n-1; i++) {
+        assert(m_x[i]<m_x[i+1]);
+    }
+
+    // same equation system for b[] as spline::set_points(), kept as the
+    // three diagonals: lower[i]*b[i-1] + diag[i]*b[i] + upper[i]*b[i+1] = rhs[i]
+    std::array<double,N> lower, diag, upper, rhs;
+    for(int i=1; i<n-1; i++) {
+        lower[i]=1.0/3.0*(x[i]-x[i-1]);
+        diag[i]=2.0/3.0*(x[i+1]-x[i-1]);
+        upper[i]=1.0/3.0*(x[i+1]-x[i]);
+        rhs[i]=(y[i+1]-y[i])/(x[i+1]-x[i]) - (y[i]-y[i-1])/(x[i]-x[i-1]);
+    }
+    lower[0]=0.0;
+    if(m_left == spline::first_deriv) {
+        // (2b[0]+b[1])(x[1]-x[0]) = 3 ((y[1]-y[0])/(x[1]-x[0]) - f')
+        diag[0]=2.0*(x[1]-x[0]);
+        upper[0]=1.0*(x[1]-x[0]);
+        rhs[0]=3.0*((y[1]-y[0])/(x[1]-x[0])-m_left_value);
+    } else {
+        assert(m_left == spline::second_deriv);
+        // 2*b[0] = f''
+        diag[0]=2.0;
+        upper[0]=0.0;
+        rhs[0]=m_left_value;
+    }
+    upper[n-1]=0.0;
+    if(m_right == spline::first_deriv) {
+        // (b[n-2]+2b[n-1])(x[n-1]-x[n-2]) = 3 (f' - (y[n-1]-y[n-2])/(x[n-1]-x[n-2]))
+        diag[n-1]=2.0*(x[n-1]-x[n-2]);
+        lower[n-1]=1.0*(x[n-1]-x[n-2]);
+        rhs[n-1]=3.0*(m_right_value-(y[n-1]-y[n-2])/(x[n-1]-x[n-2]));
+    } else {
+        assert(m_right == spline::second_deriv);
+        // 2*b[n-1] = f''
+        diag[n-1]=2.0;
+        lower[n-1]=0.0;
+        rhs[n-1]=m_right_value;
+    }
+
+    std::array<double,N> scratch;
+    thomas_solve(n,lower.data(),diag.data(),upper.data(),rhs.data(),
+                 m_b.data(),scratch.data());
+
+    // calculate parameters a[] and c[] based on b[]
+    for(int i=0; i<n-1; i++) {
+        m_a[i]=1.0/3.0*(m_b[i+1]-m_b[i])/(x[i+1]-x[i]);
+        m_c[i]=(y[i+1]-y[i])/(x[i+1]-x[i])
+               - 1.0/3.0*(2.0*m_b[i]+m_b[i+1])*(x[i+1]-x[i]);
+    }
+
+    // for left extrapolation coefficients
+    m_b0 = (m_force_linear_extrapolation==false) ? m_b[0] : 0.0;
+    m_c0 = m_c[0];
+
+    // for the right extrapolation coefficients
+    double h=x[n-1]-x[n-2];
+    m_a[n-1]=0.0;
+    m_c[n-1]=3.0*m_a[n-2]*h*h+2.0*m_b[n-2]*h+m_c[n-2];   // = f'_{n-2}(x_{n-1})
+    if(m_force_linear_extrapolation==true)
+        m_b[n-1]=0.0;
+
+    deriv_bounds_impl(m_x.data(),m_a.data(),m_b.data(),N,
+                      m_dd_max.data(),m_ddd_max.data());
+}
+
+template <size_t N>
+double fixed_spline<N>::operator() (double x) const
+{
+    // find the closest point m_x[idx] < x, idx=0 even if x<m_x[0]
+    typename std::array<double,N>::const_iterator it;
+    it=std::lower_bound(m_x.begin(),m_x.end(),x);
+    int idx=std::max( int(it-m_x.begin())-1, 0);
+
+    double h=x-m_x[idx];
+    double interpol;
+    if(x<m_x[0]) {
+        // extrapolation to the left
+        interpol=(m_b0*h + m_c0)*h + m_y[0];
+    } else if(x>m_x[N-1]) {
+        // extrapolation to the right
+        interpol=(m_b[N-1]*h + m_c[N-1])*h + m_y[N-1];
+    } else {
+        // interpolation
+        interpol=((m_a[idx]*h + m_b[idx])*h + m_c[idx])*h + m_y[idx];
+    }
+    return interpol;
+}
+
+template <size_t N>
+void fixed_spline<N>::eval_sorted(const double* xs, double* ys, size_t n,
+                                  double* dys, double* ddys) const
+{
+    eval_sorted_strided(xs,1,ys,1,n,dys,ddys,1);
+}
+
+template <size_t N>
+void fixed_spline<N>::eval_sorted_strided(const double* xs, size_t x_stride,
+        double* ys, size_t y_stride, size_t n,
+        double* dys, double* ddys, size_t d_stride) const
+{
+    eval_sorted_impl(m_x.data(),m_y.data(),m_a.data(),m_b.data(),m_c.data(),
+                     N,m_b0,m_c0,xs,x_stride,ys,y_stride,n,
+                     dys,ddys,d_stride);
+}
+
+template <size_t N>
+double fixed_spline<N>::deriv(int order, double x) const
+{
+    return deriv_impl(order,x,m_x.data(),m_a.data(),m_b.data(),m_c.data(),
+                      N,m_b0,m_c0);
+}
+
+template <size_t N>
+void fixed_spline<N>::curvature_sorted(const double* xs, double* kappa,
+                                       size_t n) const
+{
+    curvature_sorted_impl(*this,xs,kappa,n);
+}
+
+template <size_t N>
+double fixed_spline<N>::max_abs_deriv(int order) const
+{
+    return max_abs_deriv_impl(order,m_dd_max.data(),m_ddd_max.data(),N);
+}
+
+
+// spline2d implementation
+// -----------------------
+
+template <size_t N>
+void spline2d<N>::set_points(const double* x, const double* y)
+{
+    const int n=N;
+    m_t[0]=0.0;
+    for(int i=0; i<n; i++) {
+        m_x[i]=x[i];
+        m_y[i]=y[i];
+        if(i>0) {
+            m_t[i]=m_t[i-1]+std::sqrt((x[i]-x[i-1])*(x[i]-x[i-1])
+                                      +(y[i]-y[i-1])*(y[i]-y[i-1]));
+            assert(m_t[i-1]<m_t[i]);        // points must be distinct
+        }
+    }
+
+    // the matrix only depends on t, as in fixed_spline::set_points() with
+    // second_deriv boundaries of value 0
+    std::array<double,N> lower, diag, upper, rhs_x, rhs_y;
+    for(int i=1; i<n-1; i++) {
+        double h0=m_t[i]-m_t[i-1];
+        double h1=m_t[i+1]-m_t[i];
+        lower[i]=1.0/3.0*h0;
+        diag[i]=2.0/3.0*(h0+h1);
+        upper[i]=1.0/3.0*h1;
+        rhs_x[i]=(x[i+1]-x[i])/h1 - (x[i]-x[i-1])/h0;
+        rhs_y[i]=(y[i+1]-y[i])/h1 - (y[i]-y[i-1])/h0;
+    }
+    lower[0]=0.0;
+    diag[0]=2.0;
+    upper[0]=0.0;
+    rhs_x[0]=rhs_y[0]=0.0;
+    lower[n-1]=0.0;
+    diag[n-1]=2.0;
+    upper[n-1]=0.0;
+    rhs_x[n-1]=rhs_y[n-1]=0.0;
 
+    std::array<double,N> c, pivot;
+    thomas_factor(n,lower.data(),diag.data(),upper.data(),c.data(),pivot.data());
+    thomas_apply(n,lower.data(),c.data(),pivot.data(),rhs_x.data(),m_bx.data());
+    thomas_apply(n,lower.data(),c.data(),pivot.data(),rhs_y.data(),m_by.data());
 
-} // namespace
+    set_coefficients(m_x,m_ax,m_bx,m_cx);
+    set_coefficients(m_y,m_ay,m_by,m_cy);
+
+    for(int i=0; i<n-1; i++) {
+        double h=m_t[i+1]-m_t[i];
+        double ddx0=2.0*m_bx[i], ddx1=6.0*m_ax[i]*h + 2.0*m_bx[i];
+        double ddy0=2.0*m_by[i], ddy1=6.0*m_ay[i]*h + 2.0*m_by[i];
+        m_dd_max[i]=std::max(std::sqrt(ddx0*ddx0 + ddy0*ddy0),
+                             std::sqrt(ddx1*ddx1 + ddy1*ddy1));
+        m_ddd_max[i]=6.0*std::sqrt(m_ax[i]*m_ax[i] + m_ay[i]*m_ay[i]);
+    }
+}
+
+template <size_t N>
+void spline2d<N>::set_coefficients(const std::array<double,N>& v,
+                                   std::array<double,N>& a,
+                                   const std::array<double,N>& b,
+                                   std::array<double,N>& c)
+{
+    const int n=N;
+    for(int i=0; i<n-1; i++) {
+        double h=m_t[i+1]-m_t[i];
+        a[i]=1.0/3.0*(b[i+1]-b[i])/h;
+        c[i]=(v[i+1]-v[i])/h - 1.0/3.0*(2.0*b[i]+b[i+1])*h;
+    }
+    // past the last point the curve goes on along its end tangent, b[n-1]
+    // is zero by the boundary condition
+    double h=m_t[n-1]-m_t[n-2];
+    a[n-1]=0.0;
+    c[n-1]=3.0*a[n-2]*h*h+2.0*b[n-2]*h+c[n-2];
+}
+
+template <size_t N>
+void spline2d<N>::operator() (double t, double& x, double& y) const
+{
+    eval_sorted(&t,&x,&y,1);
+}
+
+template <size_t N>
+void spline2d<N>::eval_sorted(const double* ts, double* xs, double* ys,
+                              size_t n, double* dxs, double* dys,
+                              double* ddxs, double* ddys) const
+{
+    const int n_pts=N;
+    int idx=0;
+    for(size_t k=0; k<n; k++) {
+        double t=ts[k];
+        // closest point m_t[idx] < t, idx=0 even if t<m_t[0]
+        while(idx+1<n_pts && m_t[idx+1]<t) idx++;
+        double h=t-m_t[idx];
+        // before the first point the cubic term is dropped and, with b[0]
+        // zero, the curve goes on along its start tangent
+        double ax=(t<m_t[0]) ? 0.0 : m_ax[idx];
+        double ay=(t<m_t[0]) ? 0.0 : m_ay[idx];
+        xs[k]=((ax*h + m_bx[idx])*h + m_cx[idx])*h + m_x[idx];
+        ys[k]=((ay*h + m_by[idx])*h + m_cy[idx])*h + m_y[idx];
+        if(dxs!=NULL) {
+            dxs[k]=(3.0*ax*h + 2.0*m_bx[idx])*h + m_cx[idx];
+        }
+        if(dys!=NULL) {
+            dys[k]=(3.0*ay*h + 2.0*m_by[idx])*h + m_cy[idx];
+        }
+        if(ddxs!=NULL) {
+            ddxs[k]=6.0*ax*h + 2.0*m_bx[idx];
+        }
+        if(ddys!=NULL) {
+            ddys[k]=6.0*ay*h + 2.0*m_by[idx];
+        }
+    }
+}
+
+template <size_t N>
+size_t spline2d<N>::segment(double t) const
+{
+    // first point m_t[idx+1] >= t, clamped to the segments
+    typename std::array<double,N>::const_iterator it;
+    it=std::lower_bound(m_t.begin()+1,m_t.end()-1,t);
+    return it-(m_t.begin()+1);
+}
+
+template <size_t N>
+void spline2d<N>::deriv(int order, double t, double& dx, double& dy) const
+{
+    assert(order>0);
+    // outside the points the curve is cubic-free, see eval_sorted()
+    size_t idx=(t>m_t[N-1]) ? N-1 : segment(t);
+    double h=t-m_t[idx];
+    double ax=(t<m_t[0]) ? 0.0 : m_ax[idx];
+    double ay=(t<m_t[0]) ? 0.0 : m_ay[idx];
+    switch(order) {
+    case 1:
+        dx=(3.0*ax*h + 2.0*m_bx[idx])*h + m_cx[idx];
+        dy=(3.0*ay*h + 2.0*m_by[idx])*h + m_cy[idx];
+        break;
+    case 2:
+        dx=6.0*ax*h + 2.0*m_bx[idx];
+        dy=6.0*ay*h + 2.0*m_by[idx];
+        break;
+    case 3:
+        dx=6.0*ax;
+        dy=6.0*ay;
+        break;
+    default:
+        dx=dy=0.0;
+        break;
+    }
+}
+
+template <size_t N>
+void spline2d<N>::curvature_sorted(const double* ts, double* kappa,
+                                   size_t n) const
+{
+    const size_t block=64;
+    double x[block], y[block], dx[block], dy[block], ddx[block], ddy[block];
+    for(size_t start=0; start<n; start+=block) {
+        size_t len=std::min(block, n-start);
+        eval_sorted(ts+start, x, y, len, dx, dy, ddx, ddy);
+        for(size_t k=0; k<len; k++) {
+            double speed2=dx[k]*dx[k] + dy[k]*dy[k];
+            kappa[start+k]=(dx[k]*ddy[k] - dy[k]*ddx[k])
+                           /(speed2*std::sqrt(speed2));
+        }
+    }
+}
+
+} // namespace tk
 
 #endif /* TK_SPLINE_H */
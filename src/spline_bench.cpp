@@ -0,0 +1,248 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "spline.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+const int anchors = 5;
+const int points = 50;
+
+/****************************************************************/
+/* Anchor sets shaped like the planner's, in car coordinates: the last
+ * two points of the previous path and three points 30 m apart ahead,
+ * up to a lane change to either side */
+/****************************************************************/
+static void makeAnchors(int count, vector<double> &xs, vector<double> &ys)
+{
+    mt19937 random(1);
+    uniform_real_distribution<double> step(0.2, 0.5);
+    uniform_real_distribution<double> lateral(-4.5, 4.5);
+    uniform_real_distribution<double> wobble(-0.05, 0.05);
+    for(int f = 0; f < count; f++)
+    {
+        double shift = lateral(random);
+        double x[anchors] = {-step(random), 0, 30, 60, 90};
+        double y[anchors] = {wobble(random), 0, shift * 0.5 + wobble(random), shift, shift};
+        xs.insert(xs.end(), x, x + anchors);
+        ys.insert(ys.end(), y, y + anchors);
+    }
+}
+
+static double relative(double a, double b)
+{
+    return fabs(a - b) / max(1.0, fabs(b));
+}
+
+// The system tk::spline solves for b[] with zero curvature at both ends
+static void assemble(const vector<double> &x, const vector<double> &y, tk::band_matrix &A, vector<double> &rhs)
+{
+    int n = x.size();
+    A.resize(n, 1, 1);
+    rhs.assign(n, 0.0);
+    for(int i = 1; i < n - 1; i++)
+    {
+        A(i, i - 1) = 1.0 / 3.0 * (x[i] - x[i - 1]);
+        A(i, i) = 2.0 / 3.0 * (x[i + 1] - x[i - 1]);
+        A(i, i + 1) = 1.0 / 3.0 * (x[i + 1] - x[i]);
+        rhs[i] = (y[i + 1] - y[i]) / (x[i + 1] - x[i]) - (y[i] - y[i - 1]) / (x[i] - x[i - 1]);
+    }
+    A(0, 0) = 2.0;
+    A(n - 1, n - 1) = 2.0;
+}
+
+/****************************************************************/
+/* Fits and evaluates the trajectory splines the way the planner does,
+ * 5 anchors and 50 points per fit, and compares tk::fixed_spline and
+ * tk::spline2d with tk::spline on the same anchors. Then solves the
+ * spline system of 5, 50 and 5000 points with the banded LU solver and
+ * with the Thomas algorithm band_matrix::solve_into() takes for it.
+ * Fails unless every value agrees to 1e-12: spline_bench [fits] [passes] */
+/****************************************************************/
+int main(int argc, char *argv[])
+{
+    int fits = (argc > 1) ? atoi(argv[1]) : 10000;
+    int passes = (argc > 2) ? atoi(argv[2]) : 20;
+
+    vector<double> anchor_x, anchor_y;
+    makeAnchors(fits, anchor_x, anchor_y);
+
+    double xs[points];
+    for(int i = 0; i < points; i++)
+    {
+        xs[i] = 0.45 * (i + 1);
+    }
+
+    // y = f(x): tk::spline against tk::fixed_spline
+    double worst_fixed = 0;
+    tk::spline fit;
+    tk::fixed_spline<anchors> fixed_fit;
+    vector<double> x(anchors), y(anchors);
+    double values[points];
+    for(int f = 0; f < fits; f++)
+    {
+        x.assign(&anchor_x[f * anchors], &anchor_x[f * anchors] + anchors);
+        y.assign(&anchor_y[f * anchors], &anchor_y[f * anchors] + anchors);
+        fit.set_points(x, y);
+        fixed_fit.set_points(x.data(), y.data());
+        fixed_fit.eval_sorted(xs, values, points);
+        for(int i = 0; i < points; i++)
+        {
+            worst_fixed = max(worst_fixed, relative(fixed_fit(xs[i]), fit(xs[i])));
+            worst_fixed = max(worst_fixed, relative(values[i], fit(xs[i])));
+        }
+    }
+
+    // x(t), y(t) over the chord length: two tk::splines against tk::spline2d
+    double worst_2d = 0;
+    tk::spline fit_x, fit_y;
+    tk::spline2d<anchors> fit_2d;
+    vector<double> t(anchors);
+    double ts[points], px[points], py[points];
+    for(int f = 0; f < fits; f++)
+    {
+        const double *ax = &anchor_x[f * anchors], *ay = &anchor_y[f * anchors];
+        fit_2d.set_points(ax, ay);
+        for(int k = 0; k < anchors; k++)
+        {
+            t[k] = fit_2d.t_at(k);
+            x[k] = ax[k];
+            y[k] = ay[k];
+        }
+        fit_x.set_points(t, x);
+        fit_y.set_points(t, y);
+        for(int i = 0; i < points; i++)
+        {
+            ts[i] = t[1] + (t[anchors - 1] - t[1]) * (i + 1) / (2 * points);
+        }
+        fit_2d.eval_sorted(ts, px, py, points);
+        for(int i = 0; i < points; i++)
+        {
+            worst_2d = max(worst_2d, relative(px[i], fit_x(ts[i])));
+            worst_2d = max(worst_2d, relative(py[i], fit_y(ts[i])));
+        }
+    }
+
+    double sink = 0;
+    Clock::time_point start = Clock::now();
+    for(int p = 0; p < passes; p++)
+    {
+        for(int f = 0; f < fits; f++)
+        {
+            x.assign(&anchor_x[f * anchors], &anchor_x[f * anchors] + anchors);
+            y.assign(&anchor_y[f * anchors], &anchor_y[f * anchors] + anchors);
+            fit.set_points(x, y);
+            for(int i = 0; i < points; i++)
+            {
+                sink += fit(xs[i]);
+            }
+        }
+    }
+    double spline_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (passes * fits);
+
+    start = Clock::now();
+    for(int p = 0; p < passes; p++)
+    {
+        for(int f = 0; f < fits; f++)
+        {
+            fixed_fit.set_points(&anchor_x[f * anchors], &anchor_y[f * anchors]);
+            for(int i = 0; i < points; i++)
+            {
+                sink += fixed_fit(xs[i]);
+            }
+        }
+    }
+    double fixed_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (passes * fits);
+
+    start = Clock::now();
+    for(int p = 0; p < passes; p++)
+    {
+        for(int f = 0; f < fits; f++)
+        {
+            fixed_fit.set_points(&anchor_x[f * anchors], &anchor_y[f * anchors]);
+            fixed_fit.eval_sorted(xs, values, points);
+            sink += values[points - 1];
+        }
+    }
+    double sorted_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (passes * fits);
+
+    start = Clock::now();
+    for(int p = 0; p < passes; p++)
+    {
+        for(int f = 0; f < fits; f++)
+        {
+            fit_2d.set_points(&anchor_x[f * anchors], &anchor_y[f * anchors]);
+            fit_2d.eval_sorted(ts, px, py, points);
+            sink += px[points - 1] + py[points - 1];
+        }
+    }
+    double fit_2d_ns = chrono::duration<double, nano>(Clock::now() - start).count() / (passes * fits);
+
+    // Tridiagonal systems: the banded LU solver against Thomas, assembly included
+    const int sizes[] = {5, 50, 5000};
+    double worst_solve = 0;
+    double lu_ns[3], thomas_ns[3];
+    mt19937 random(2);
+    uniform_real_distribution<double> spacing(0.5, 30), height(-5, 5);
+    for(int k = 0; k < 3; k++)
+    {
+        int n = sizes[k];
+        vector<double> sx(n), sy(n);
+        for(int i = 0; i < n; i++)
+        {
+            sx[i] = (i > 0) ? sx[i - 1] + spacing(random) : 0.0;
+            sy[i] = height(random);
+        }
+        tk::band_matrix A;
+        vector<double> rhs, lu_x, thomas_x, work;
+        assemble(sx, sy, A, rhs);
+        A.lu_solve(rhs, lu_x, work);
+        assemble(sx, sy, A, rhs);
+        A.solve_into(rhs, thomas_x, work);
+        for(int i = 0; i < n; i++)
+        {
+            worst_solve = max(worst_solve, relative(thomas_x[i], lu_x[i]));
+        }
+
+        int solves = passes * 50000 / n + 1;
+        start = Clock::now();
+        for(int p = 0; p < solves; p++)
+        {
+            assemble(sx, sy, A, rhs);
+            A.lu_solve(rhs, lu_x, work);
+            sink += lu_x[n / 2];
+        }
+        lu_ns[k] = chrono::duration<double, nano>(Clock::now() - start).count() / solves;
+
+        start = Clock::now();
+        for(int p = 0; p < solves; p++)
+        {
+            assemble(sx, sy, A, rhs);
+            A.solve_into(rhs, thomas_x, work);
+            sink += thomas_x[n / 2];
+        }
+        thomas_ns[k] = chrono::duration<double, nano>(Clock::now() - start).count() / solves;
+    }
+
+    bool exact = worst_fixed <= 1e-12 && worst_2d <= 1e-12 && worst_solve <= 1e-12;
+    cout << fits << " fits of " << anchors << " anchors, " << points << " points each" << endl;
+    cout << "largest relative difference to tk::spline: fixed_spline " << worst_fixed << ", spline2d "
+         << worst_2d << (exact ? "" : " (too large)") << endl;
+    cout << "tk::spline " << spline_ns << " ns/fit, fixed_spline " << fixed_ns << " ns/fit "
+         << spline_ns / fixed_ns << "x, with eval_sorted " << sorted_ns << " ns/fit " << spline_ns / sorted_ns
+         << "x" << endl;
+    cout << "spline2d " << fit_2d_ns << " ns/fit with eval_sorted" << endl;
+    cout << "largest relative difference of Thomas to banded LU " << worst_solve << (exact ? "" : " (too large)")
+         << endl;
+    for(int k = 0; k < 3; k++)
+    {
+        cout << sizes[k] << " points: banded LU " << lu_ns[k] << " ns/solve, Thomas " << thomas_ns[k]
+             << " ns/solve " << lu_ns[k] / thomas_ns[k] << "x" << (sink == 0 ? " " : "") << endl;
+    }
+    return exact ? 0 : 1;
+}
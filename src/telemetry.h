@@ -0,0 +1,558 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "json.hpp"
+
+// Checks if the SocketIO event has JSON data.
+// If there is data the JSON object in string format will be returned,
+// else the empty string "" will be returned.
+inline std::string hasData(const std::string &s) {
+  auto found_null = s.find("null");
+  auto b1 = s.find_first_of("[");
+  auto b2 = s.find_first_of("}");
+  if (found_null != std::string::npos) {
+    return "";
+  } else if (b1 != std::string::npos && b2 != std::string::npos) {
+    return s.substr(b1, b2 - b1 + 2);
+  }
+  return "";
+}
+
+/****************************************************************/
+/* Another car as reported by sensor fusion */
+/****************************************************************/
+struct SensorCar
+{
+    int id;
+    double x, y;
+    double vx, vy;
+    double s, d;
+};
+
+/****************************************************************/
+/* One telemetry frame of the simulator, see the README for the
+ * meaning of the fields. Reused from frame to frame, so once the
+ * vectors have grown filling it does not allocate */
+/****************************************************************/
+struct Telemetry
+{
+    // Main car's localization data
+    double x = 0, y = 0;
+    double s = 0, d = 0;
+    double yaw = 0;                     // degrees
+    double speed = 0;                   // mph
+
+    // Previous path given to the planner, not yet driven
+    std::vector<double> previous_path_x;
+    std::vector<double> previous_path_y;
+    double end_path_s = 0, end_path_d = 0;
+
+    std::vector<SensorCar> sensor_fusion;
+
+    void reserve(int path_points, int cars)
+    {
+        previous_path_x.reserve(path_points);
+        previous_path_y.reserve(path_points);
+        sensor_fusion.reserve(cars);
+    }
+};
+
+/****************************************************************/
+/* Reads the telemetry object j[1] of a parsed frame, the slow path
+ * for frames the streaming parser does not take */
+/****************************************************************/
+inline void telemetryFromJson(const nlohmann::json &j, Telemetry &out)
+{
+    out.x = j["x"];
+    out.y = j["y"];
+    out.s = j["s"];
+    out.d = j["d"];
+    out.yaw = j["yaw"];
+    out.speed = j["speed"];
+
+    const nlohmann::json &path_x = j["previous_path_x"];
+    const nlohmann::json &path_y = j["previous_path_y"];
+    out.previous_path_x.clear();
+    out.previous_path_y.clear();
+    for(const nlohmann::json &v : path_x)
+    {
+        out.previous_path_x.push_back(v);
+    }
+    for(const nlohmann::json &v : path_y)
+    {
+        out.previous_path_y.push_back(v);
+    }
+    out.end_path_s = j["end_path_s"];
+    out.end_path_d = j["end_path_d"];
+
+    out.sensor_fusion.clear();
+    for(const nlohmann::json &car : j["sensor_fusion"])
+    {
+        SensorCar c;
+        c.id = car[0];
+        c.x = car[1];
+        c.y = car[2];
+        c.vx = car[3];
+        c.vy = car[4];
+        c.s = car[5];
+        c.d = car[6];
+        out.sensor_fusion.push_back(c);
+    }
+}
+
+/****************************************************************/
+/* Streaming parser for exactly the telemetry frame the simulator sends,
+ * 42["telemetry",{...}]. Walks the text once and writes the values
+ * straight into a Telemetry, without building a DOM or copying strings.
+ * Keys may come in any order and unknown ones are skipped. Anything
+ * else, the manual frame, escapes in keys or a missing field, makes
+ * parse() return false and is left to the json path. parseControl()
+ * reads the planner's reply, 42["control",{...}], the same way for
+ * the headless simulator */
+/****************************************************************/
+class TelemetryParser
+{
+public:
+    static bool parse(const char *data, size_t length, Telemetry &out)
+    {
+        TelemetryParser parser(data, data + length);
+        return parser.frame(out);
+    }
+
+    static bool parseControl(const char *data, size_t length, std::vector<double> &next_x,
+                             std::vector<double> &next_y)
+    {
+        TelemetryParser parser(data, data + length);
+        return parser.control(next_x, next_y);
+    }
+
+private:
+    enum Field : uint32_t
+    {
+        field_x = 1 << 0,
+        field_y = 1 << 1,
+        field_s = 1 << 2,
+        field_d = 1 << 3,
+        field_yaw = 1 << 4,
+        field_speed = 1 << 5,
+        field_path_x = 1 << 6,
+        field_path_y = 1 << 7,
+        field_end_s = 1 << 8,
+        field_end_d = 1 << 9,
+        field_sensor_fusion = 1 << 10,
+        all_fields = (1 << 11) - 1
+    };
+
+    // Nesting allowed in skipped values
+    static const int max_depth = 16;
+
+    TelemetryParser(const char *begin, const char *end) : m_p(begin), m_end(end) {}
+
+    void space()
+    {
+        while(m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+        {
+            m_p++;
+        }
+    }
+
+    bool peek(char c)
+    {
+        space();
+        return m_p < m_end && *m_p == c;
+    }
+
+    bool expect(char c)
+    {
+        if(!peek(c))
+        {
+            return false;
+        }
+        m_p++;
+        return true;
+    }
+
+    // Exact match of a literal at the cursor
+    bool literal(const char *text)
+    {
+        size_t n = strlen(text);
+        if((size_t)(m_end - m_p) < n || memcmp(m_p, text, n) != 0)
+        {
+            return false;
+        }
+        m_p += n;
+        return true;
+    }
+
+    // String without escapes, returned in place
+    bool quoted(const char *&text, size_t &length)
+    {
+        if(!expect('"'))
+        {
+            return false;
+        }
+        text = m_p;
+        while(m_p < m_end && *m_p != '"')
+        {
+            if(*m_p == '\\')
+            {
+                return false;
+            }
+            m_p++;
+        }
+        if(m_p == m_end)
+        {
+            return false;
+        }
+        length = m_p - text;
+        m_p++;
+        return true;
+    }
+
+    bool number(double &value)
+    {
+        space();
+        const char *p = m_p;
+        bool negative = (p < m_end && *p == '-');
+        if(negative)
+        {
+            p++;
+        }
+
+        // Up to 19 significant digits fit the mantissa
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        const char *first = p;
+        while(p < m_end && *p >= '0' && *p <= '9')
+        {
+            mantissa = mantissa * 10 + (*p++ - '0');
+            digits++;
+        }
+        if(p == first)
+        {
+            return false;
+        }
+        if(p < m_end && *p == '.')
+        {
+            first = ++p;
+            while(p < m_end && *p >= '0' && *p <= '9')
+            {
+                mantissa = mantissa * 10 + (*p++ - '0');
+                digits++;
+                exponent--;
+            }
+            if(p == first)
+            {
+                return false;
+            }
+        }
+        if(p < m_end && (*p == 'e' || *p == 'E'))
+        {
+            p++;
+            bool negative_exponent = (p < m_end && *p == '-');
+            if(p < m_end && (*p == '-' || *p == '+'))
+            {
+                p++;
+            }
+            first = p;
+            int e = 0;
+            while(p < m_end && *p >= '0' && *p <= '9')
+            {
+                e = std::min(e * 10 + (*p++ - '0'), 10000);
+            }
+            if(p == first)
+            {
+                return false;
+            }
+            exponent += negative_exponent ? -e : e;
+        }
+
+        // A mantissa and power of ten both exact in a double give the
+        // correctly rounded value in one operation, the same strtod gives
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        if(digits <= 19 && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+        {
+            value = (exponent < 0) ? (double)mantissa / powers[-exponent] : (double)mantissa * powers[exponent];
+            value = negative ? -value : value;
+        }
+        else
+        {
+            // strtod needs a terminated string, numbers are short
+            char buffer[64];
+            size_t n = p - m_p;
+            if(n >= sizeof(buffer))
+            {
+                return false;
+            }
+            memcpy(buffer, m_p, n);
+            buffer[n] = '\0';
+            value = strtod(buffer, nullptr);
+        }
+        m_p = p;
+        return true;
+    }
+
+    bool numbers(std::vector<double> &values)
+    {
+        values.clear();
+        if(!expect('['))
+        {
+            return false;
+        }
+        if(expect(']'))
+        {
+            return true;
+        }
+        do
+        {
+            double value;
+            if(!number(value))
+            {
+                return false;
+            }
+            values.push_back(value);
+        } while(expect(','));
+        return expect(']');
+    }
+
+    bool cars(std::vector<SensorCar> &cars)
+    {
+        cars.clear();
+        if(!expect('['))
+        {
+            return false;
+        }
+        if(expect(']'))
+        {
+            return true;
+        }
+        do
+        {
+            // [id, x, y, vx, vy, s, d]
+            double id;
+            SensorCar car;
+            if(!expect('[') || !number(id)
+               || !expect(',') || !number(car.x) || !expect(',') || !number(car.y)
+               || !expect(',') || !number(car.vx) || !expect(',') || !number(car.vy)
+               || !expect(',') || !number(car.s) || !expect(',') || !number(car.d)
+               || !expect(']'))
+            {
+                return false;
+            }
+            car.id = (int)id;
+            cars.push_back(car);
+        } while(expect(','));
+        return expect(']');
+    }
+
+    // Any json value whose content is not needed
+    bool skip(int depth)
+    {
+        space();
+        if(depth > max_depth || m_p == m_end)
+        {
+            return false;
+        }
+        const char *text;
+        size_t length;
+        double value;
+        switch(*m_p)
+        {
+        case '"':
+            // Escaped strings are not worth a skipping path of their own
+            return quoted(text, length);
+        case '[':
+        case '{':
+        {
+            bool object = (*m_p == '{');
+            char close = object ? '}' : ']';
+            m_p++;
+            if(expect(close))
+            {
+                return true;
+            }
+            do
+            {
+                if(object && (!quoted(text, length) || !expect(':')))
+                {
+                    return false;
+                }
+                if(!skip(depth + 1))
+                {
+                    return false;
+                }
+            } while(expect(','));
+            return expect(close);
+        }
+        case 't':
+            return literal("true");
+        case 'f':
+            return literal("false");
+        case 'n':
+            return literal("null");
+        default:
+            return number(value);
+        }
+    }
+
+    static bool is(const char *text, size_t length, const char *key)
+    {
+        return strlen(key) == length && memcmp(text, key, length) == 0;
+    }
+
+    bool field(const char *key, size_t length, Telemetry &out, uint32_t &seen)
+    {
+        uint32_t bit = 0;
+        bool ok = true;
+        if(is(key, length, "x"))
+        {
+            bit = field_x;
+            ok = number(out.x);
+        }
+        else if(is(key, length, "y"))
+        {
+            bit = field_y;
+            ok = number(out.y);
+        }
+        else if(is(key, length, "s"))
+        {
+            bit = field_s;
+            ok = number(out.s);
+        }
+        else if(is(key, length, "d"))
+        {
+            bit = field_d;
+            ok = number(out.d);
+        }
+        else if(is(key, length, "yaw"))
+        {
+            bit = field_yaw;
+            ok = number(out.yaw);
+        }
+        else if(is(key, length, "speed"))
+        {
+            bit = field_speed;
+            ok = number(out.speed);
+        }
+        else if(is(key, length, "previous_path_x"))
+        {
+            bit = field_path_x;
+            ok = numbers(out.previous_path_x);
+        }
+        else if(is(key, length, "previous_path_y"))
+        {
+            bit = field_path_y;
+            ok = numbers(out.previous_path_y);
+        }
+        else if(is(key, length, "end_path_s"))
+        {
+            bit = field_end_s;
+            ok = number(out.end_path_s);
+        }
+        else if(is(key, length, "end_path_d"))
+        {
+            bit = field_end_d;
+            ok = number(out.end_path_d);
+        }
+        else if(is(key, length, "sensor_fusion"))
+        {
+            bit = field_sensor_fusion;
+            ok = cars(out.sensor_fusion);
+        }
+        else
+        {
+            ok = skip(0);
+        }
+        seen |= bit;
+        return ok;
+    }
+
+    bool frame(Telemetry &out)
+    {
+        const char *text;
+        size_t length;
+        if(!literal("42") || !expect('[') || !quoted(text, length) || !is(text, length, "telemetry")
+           || !expect(',') || !expect('{'))
+        {
+            return false;
+        }
+        uint32_t seen = 0;
+        if(!peek('}'))
+        {
+            do
+            {
+                if(!quoted(text, length) || !expect(':') || !field(text, length, out, seen))
+                {
+                    return false;
+                }
+            } while(expect(','));
+        }
+        if(!expect('}') || !expect(']'))
+        {
+            return false;
+        }
+        space();
+        return m_p == m_end && seen == all_fields
+               && out.previous_path_x.size() == out.previous_path_y.size();
+    }
+
+    bool control(std::vector<double> &next_x, std::vector<double> &next_y)
+    {
+        const char *text;
+        size_t length;
+        if(!literal("42") || !expect('[') || !quoted(text, length) || !is(text, length, "control")
+           || !expect(',') || !expect('{'))
+        {
+            return false;
+        }
+        bool seen_x = false, seen_y = false;
+        if(!peek('}'))
+        {
+            do
+            {
+                if(!quoted(text, length) || !expect(':'))
+                {
+                    return false;
+                }
+                bool ok;
+                if(is(text, length, "next_x"))
+                {
+                    seen_x = true;
+                    ok = numbers(next_x);
+                }
+                else if(is(text, length, "next_y"))
+                {
+                    seen_y = true;
+                    ok = numbers(next_y);
+                }
+                else
+                {
+                    ok = skip(0);
+                }
+                if(!ok)
+                {
+                    return false;
+                }
+            } while(expect(','));
+        }
+        if(!expect('}') || !expect(']'))
+        {
+            return false;
+        }
+        space();
+        return m_p == m_end && seen_x && seen_y && next_x.size() == next_y.size();
+    }
+
+    const char *m_p;
+    const char *m_end;
+};
+
+#endif /* TELEMETRY_H */
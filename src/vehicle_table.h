@@ -0,0 +1,237 @@
+#ifndef VEHICLE_TABLE_H
+#define VEHICLE_TABLE_H
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+/****************************************************************/
+/* Other vehicles of one cycle in structure-of-arrays layout, bucketed
+ * by lane and sorted by predicted s within each bucket. The sensor data
+ * is decoded once per cycle, after which the nearest leader or follower
+ * in a lane is a binary search. Works for any number of lanes; with a
+ * track length set, s wraps around the loop */
+/****************************************************************/
+class VehicleTable
+{
+public:
+    VehicleTable(int lanes = 3, double lane_width = 4.0, double track_length = 0);
+
+    // Keeps the columns from allocating for up to this many vehicles
+    void reserve(int vehicles);
+    void clear();
+
+    // Vehicle as reported by sensor fusion
+    void add(int id, double s, double d, double vx, double vy);
+
+    // Predicts every vehicle delay seconds ahead at constant speed along
+    // its lane, then buckets and sorts. Call after the last add()
+    void build(double delay);
+
+    int lanes() const { return m_lanes; }
+    // Lane index of a lateral position, -1 when off the road
+    int laneOf(double d) const;
+
+    // Nearest vehicle strictly ahead of s in lane, -1 if the lane is empty.
+    // gap is the distance along s to it
+    int leader(int lane, double s, double &gap) const;
+    // Nearest vehicle at or behind s in lane, -1 if the lane is empty
+    int follower(int lane, double s, double &gap) const;
+
+    // Vehicles in a lane are begin(lane) .. end(lane) - 1, sorted by s
+    int begin(int lane) const { return m_lane_begin[lane]; }
+    int end(int lane) const { return m_lane_begin[lane + 1]; }
+    int size() const { return m_lane_begin[m_lanes]; }
+
+    // Columns of the sorted table
+    int id(int i) const { return m_id[i]; }
+    double s(int i) const { return m_s[i]; }
+    double d(int i) const { return m_d[i]; }
+    double speed(int i) const { return m_speed[i]; }
+
+private:
+    double wrap(double s) const;
+
+    int m_lanes;
+    double m_lane_width;
+    double m_track_length;
+
+    // As added
+    std::vector<int> m_in_id;
+    std::vector<double> m_in_s, m_in_d, m_in_speed;
+    std::vector<int> m_lane_of;
+    std::vector<double> m_predicted;
+
+    // Sorted, lane by lane
+    std::vector<int> m_order;               // index as added
+    std::vector<int> m_lane_begin;          // lanes + 1 offsets
+    std::vector<int> m_lane_fill;
+    std::vector<int> m_id;
+    std::vector<double> m_s, m_d, m_speed;
+};
+
+inline VehicleTable::VehicleTable(int lanes, double lane_width, double track_length)
+    : m_lanes(lanes), m_lane_width(lane_width), m_track_length(track_length),
+      m_lane_begin(lanes + 1, 0), m_lane_fill(lanes, 0)
+{
+}
+
+inline void VehicleTable::reserve(int vehicles)
+{
+    m_in_id.reserve(vehicles);
+    m_in_s.reserve(vehicles);
+    m_in_d.reserve(vehicles);
+    m_in_speed.reserve(vehicles);
+    m_lane_of.reserve(vehicles);
+    m_predicted.reserve(vehicles);
+    m_order.reserve(vehicles);
+    m_id.reserve(vehicles);
+    m_s.reserve(vehicles);
+    m_d.reserve(vehicles);
+    m_speed.reserve(vehicles);
+}
+
+inline void VehicleTable::clear()
+{
+    m_in_id.clear();
+    m_in_s.clear();
+    m_in_d.clear();
+    m_in_speed.clear();
+    std::fill(m_lane_begin.begin(), m_lane_begin.end(), 0);
+}
+
+inline void VehicleTable::add(int id, double s, double d, double vx, double vy)
+{
+    m_in_id.push_back(id);
+    m_in_s.push_back(s);
+    m_in_d.push_back(d);
+    m_in_speed.push_back(sqrt(vx * vx + vy * vy));
+}
+
+inline double VehicleTable::wrap(double s) const
+{
+    if(m_track_length > 0)
+    {
+        s = fmod(s, m_track_length);
+        if(s < 0)
+        {
+            s += m_track_length;
+        }
+    }
+    return s;
+}
+
+inline int VehicleTable::laneOf(double d) const
+{
+    if(d < 0)
+    {
+        return -1;
+    }
+    int lane = (int)(d / m_lane_width);
+    return (lane < m_lanes) ? lane : -1;
+}
+
+inline void VehicleTable::build(double delay)
+{
+    int n = m_in_s.size();
+
+    // Counting sort into lane buckets, vehicles off the road are dropped
+    m_lane_of.resize(n);
+    m_predicted.resize(n);
+    std::fill(m_lane_begin.begin(), m_lane_begin.end(), 0);
+    for(int i = 0; i < n; i++)
+    {
+        m_lane_of[i] = laneOf(m_in_d[i]);
+        m_predicted[i] = wrap(m_in_s[i] + m_in_speed[i] * delay);
+        if(m_lane_of[i] >= 0)
+        {
+            m_lane_begin[m_lane_of[i] + 1]++;
+        }
+    }
+    for(int lane = 0; lane < m_lanes; lane++)
+    {
+        m_lane_begin[lane + 1] += m_lane_begin[lane];
+        m_lane_fill[lane] = m_lane_begin[lane];
+    }
+
+    int kept = m_lane_begin[m_lanes];
+    m_order.resize(kept);
+    for(int i = 0; i < n; i++)
+    {
+        if(m_lane_of[i] >= 0)
+        {
+            m_order[m_lane_fill[m_lane_of[i]]++] = i;
+        }
+    }
+
+    // Each bucket by predicted s, then gathered into the sorted columns
+    const std::vector<double> &predicted = m_predicted;
+    for(int lane = 0; lane < m_lanes; lane++)
+    {
+        std::sort(m_order.begin() + begin(lane), m_order.begin() + end(lane),
+                  [&predicted](int a, int b) { return predicted[a] < predicted[b]; });
+    }
+
+    m_id.resize(kept);
+    m_s.resize(kept);
+    m_d.resize(kept);
+    m_speed.resize(kept);
+    for(int k = 0; k < kept; k++)
+    {
+        int i = m_order[k];
+        m_id[k] = m_in_id[i];
+        m_s[k] = m_predicted[i];
+        m_d[k] = m_in_d[i];
+        m_speed[k] = m_in_speed[i];
+    }
+}
+
+inline int VehicleTable::leader(int lane, double s, double &gap) const
+{
+    int first = begin(lane), last = end(lane);
+    if(first == last)
+    {
+        return -1;
+    }
+    s = wrap(s);
+    int i = std::upper_bound(m_s.begin() + first, m_s.begin() + last, s) - m_s.begin();
+    if(i == last)
+    {
+        // Past the last one, the leader is the first one of the next lap
+        if(m_track_length <= 0)
+        {
+            return -1;
+        }
+        i = first;
+        gap = m_s[i] + m_track_length - s;
+        return i;
+    }
+    gap = m_s[i] - s;
+    return i;
+}
+
+inline int VehicleTable::follower(int lane, double s, double &gap) const
+{
+    int first = begin(lane), last = end(lane);
+    if(first == last)
+    {
+        return -1;
+    }
+    s = wrap(s);
+    int i = std::upper_bound(m_s.begin() + first, m_s.begin() + last, s) - m_s.begin() - 1;
+    if(i < first)
+    {
+        // Before the first one, the follower is the last one of the previous lap
+        if(m_track_length <= 0)
+        {
+            return -1;
+        }
+        i = last - 1;
+        gap = s + m_track_length - m_s[i];
+        return i;
+    }
+    gap = s - m_s[i];
+    return i;
+}
+
+#endif /* VEHICLE_TABLE_H */
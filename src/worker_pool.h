@@ -0,0 +1,166 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/****************************************************************/
+/* Fixed set of worker threads, started once and kept for the life of
+ * the planner. parallelFor() hands out chunks of an index range to the
+ * workers and the calling thread and returns when all are done. A job
+ * is a plain function pointer and context, so running one takes no
+ * heap allocation. Safe to call from several threads: jobs do not
+ * queue, a second caller runs its job on its own thread */
+/****************************************************************/
+class WorkerPool
+{
+public:
+    // threads is the total including the calling thread, 0 picks one per core
+    explicit WorkerPool(int threads = 0);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    // Threads taking part in a job, the caller included
+    int size() const { return m_threads.size() + 1; }
+
+    // Calls fn(begin, end) on consecutive ranges of at most chunk indices
+    // until [0, count) is covered
+    template<typename F>
+    void parallelFor(int count, int chunk, F &fn)
+    {
+        run(count, chunk, &invoke<F>, &fn);
+    }
+
+private:
+    typedef void (*Job)(void *context, int begin, int end);
+
+    template<typename F>
+    static void invoke(void *context, int begin, int end)
+    {
+        (*static_cast<F *>(context))(begin, end);
+    }
+
+    void run(int count, int chunk, Job job, void *context);
+    void work();
+    void drain();
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_job_mutex;        // held by the caller of the running job
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    uint64_t m_generation = 0;     // bumped for every job
+    int m_busy = 0;                // workers still on the current job
+    bool m_stop = false;
+
+    // Current job, written under the mutex before the workers are woken
+    Job m_job = nullptr;
+    void *m_context = nullptr;
+    int m_count = 0;
+    int m_chunk = 1;
+    std::atomic<int> m_next;       // first index not yet handed out
+};
+
+inline WorkerPool::WorkerPool(int threads) : m_next(0)
+{
+    if(threads <= 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+    for(int i = 1; i < threads; i++)
+    {
+        m_threads.push_back(std::thread(&WorkerPool::work, this));
+    }
+}
+
+inline WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for(std::thread &thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+inline void WorkerPool::drain()
+{
+    for(;;)
+    {
+        int begin = m_next.fetch_add(m_chunk);
+        if(begin >= m_count)
+        {
+            return;
+        }
+        m_job(m_context, begin, std::min(begin + m_chunk, m_count));
+    }
+}
+
+inline void WorkerPool::work()
+{
+    uint64_t seen = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+            if(m_stop)
+            {
+                return;
+            }
+            seen = m_generation;
+        }
+
+        drain();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(--m_busy == 0)
+        {
+            m_done.notify_one();
+        }
+    }
+}
+
+inline void WorkerPool::run(int count, int chunk, Job job, void *context)
+{
+    // One job at a time; a caller finding the pool taken by another one
+    // runs its own job alone instead of waiting for it
+    std::unique_lock<std::mutex> owner(m_job_mutex, std::try_to_lock);
+    if(!owner.owns_lock() || m_threads.empty())
+    {
+        chunk = std::max(chunk, 1);
+        for(int begin = 0; begin < count; begin += chunk)
+        {
+            job(context, begin, std::min(begin + chunk, count));
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = job;
+        m_context = context;
+        m_count = count;
+        m_chunk = std::max(chunk, 1);
+        m_next = 0;
+        m_busy = m_threads.size();
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    drain();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&] { return m_busy == 0; });
+}
+
+#endif /* WORKER_POOL_H */